@@ -0,0 +1,270 @@
+/*
+ * Serial bootloader, so the firmware can be updated from the router without
+ * opening the box. It lives in the 1 KB boot section at the end of the flash
+ * (BOOT_START in the Makefile), and the fuses make it start at every reset.
+ * It then waits a second for the router, and starts the firmware if nothing
+ * comes. The firmware resets into it when the router sends "bootloader" (see
+ * startBootloader() in serial.c). flash.pl on the router drives it.
+ *
+ * The protocol is binary, single byte commands with binary arguments, at the
+ * baud rate of the firmware. The router first sends BOOT_MAGIC, which holds
+ * ESC characters that none of the firmware's protocols use. Until it has come,
+ * every other byte is ignored, so neither the firmware's own traffic nor a
+ * stray 'X' in it makes the bootloader stay, let alone write or start
+ * anything:
+ *
+ *   BOOT_MAGIC                  -> '!' 'B' <pages>    pages the firmware can use
+ *   'C' <first> <count>         -> 'C' <crc>...       CRC16 of each page, low byte first
+ *   'W' <page> <data> <crc>     -> 'K' or 'E'         write one page of SPM_PAGESIZE bytes
+ *   'X'                         -> 'X' or 'E'         start the firmware
+ *
+ * The CRC is the one of _crc16_update() (poly 0xA001, start 0xFFFF). Comparing
+ * the CRCs of the pages first, the router only sends the pages that changed.
+ * A page is only written when its CRC checks out, and 'K' means it reads back
+ * correctly. A command that stops halfway for more than 100 ms is dropped.
+ *
+ * The firmware counts as present when its first word (the reset vector) is
+ * not erased. flash.pl erases page 0 before it writes anything else and writes
+ * it last, so an interrupted update leaves the bootloader waiting for the
+ * router instead of starting half a firmware.
+ *
+ * Built without the C runtime (-nostartfiles), so there are no interrupt
+ * vectors and no initialised or zeroed variables; everything is on the stack.
+ */
+
+//=========== Includes ===========
+
+#include <avr/io.h>
+#include <avr/boot.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
+
+#include "common.h"
+#include "serial.h"
+
+//=========== Defines ===========
+
+#ifndef BOOT_START
+#define	BOOT_START			0x7C00		// Byte address of the boot section, set by the Makefile
+#endif
+#define	BOOT_PAGES			(BOOT_START / SPM_PAGESIZE)		// Flash pages below the bootloader
+#define	TICKS_PER_SECOND	(F_CPU / 1024)	// Timer1 runs at F_CPU / 1024
+#define	BOOT_WAIT			TICKS_PER_SECOND		// Time to wait for the router after a reset
+#define	BYTE_TIMEOUT		(TICKS_PER_SECOND / 10)	// Longest pause within a command
+#define	BOOT_MAGIC			"\x1B" "BOOT" "\x1B"	// Sent by the router to take over, see flash.pl
+
+//=========== Function prototypes ===========
+
+// The reset jumps to BOOT_START, so main goes first in the boot section. In
+// .vectors, as the linker puts .progmem (bootMagic) ahead of the .init
+// sections. The Makefile checks where it ended up.
+int main(void) __attribute__((OS_main)) __attribute__((section(".vectors")));
+
+//=========== Local variables ===========
+
+// In flash, as there are no initialised variables
+static const char bootMagic[] PROGMEM = BOOT_MAGIC;
+
+//=========== Local functions ===========
+
+// Wait for a byte from the router. Returns -1 if none came within the given
+// number of timer ticks.
+static int readByte(unsigned int timeout)
+{
+	unsigned int start = TCNT1;
+
+	while(!(UCSR0A & (1 << RXC0)))
+	{
+		if((unsigned int)(TCNT1 - start) >= timeout)
+		{
+			return -1;
+		}
+	}
+
+	return UDR0;
+}
+
+static void writeByte(unsigned char c)
+{
+	while(!(UCSR0A & (1 << UDRE0)))
+	{
+	}
+	UCSR0A |= (1 << TXC0);		// Set again once this byte is out
+	UDR0 = c;
+}
+
+// CRC16 of a page of flash
+static unsigned int pageCrc(unsigned int address)
+{
+	unsigned int crc = 0xFFFF;
+	unsigned char i;
+
+	for(i = 0; i < SPM_PAGESIZE; i++)
+	{
+		crc = _crc16_update(crc, pgm_read_byte(address + i));
+	}
+
+	return crc;
+}
+
+// Receive the rest of a 'W' command and write the page. Returns the reply,
+// or 0 if the command was cut short.
+static unsigned char writePage(void)
+{
+	unsigned char data[SPM_PAGESIZE];
+	unsigned int crc = 0xFFFF;
+	unsigned int address;
+	int page;
+	int lo;
+	int hi;
+	unsigned char i;
+
+	page = readByte(BYTE_TIMEOUT);
+	for(i = 0; i < SPM_PAGESIZE; i++)
+	{
+		int c = readByte(BYTE_TIMEOUT);
+
+		if(c < 0)
+		{
+			return 0;
+		}
+		data[i] = c;
+		crc = _crc16_update(crc, c);
+	}
+	lo = readByte(BYTE_TIMEOUT);
+	hi = readByte(BYTE_TIMEOUT);
+
+	if(page < 0 || lo < 0 || hi < 0)
+	{
+		return 0;
+	}
+	if(page >= BOOT_PAGES || crc != (unsigned int)(lo | (hi << 8)))
+	{
+		return 'E';
+	}
+
+	address = page * SPM_PAGESIZE;
+	boot_page_erase(address);
+	boot_spm_busy_wait();
+	for(i = 0; i < SPM_PAGESIZE; i += 2)
+	{
+		boot_page_fill(address + i, data[i] | (data[i + 1] << 8));
+	}
+	boot_page_write(address);
+	boot_spm_busy_wait();
+	boot_rww_enable();		// The firmware section can be read again
+
+	return pageCrc(address) == crc ? 'K' : 'E';
+}
+
+static BOOL firmwarePresent(void)
+{
+	return pgm_read_word(0) != 0xFFFF;
+}
+
+// Leave the hardware as the firmware expects it after a reset, and start it
+static void startFirmware(void)
+{
+	UCSR0B = 0;
+	TCCR1B = 0;
+	TCNT1 = 0;
+	((void (*)(void))0)();
+}
+
+//=========== Main ===========
+
+int main(void)
+{
+	BOOL synced = FALSE;		// The router sent BOOT_MAGIC, so stay and take commands
+	unsigned char matched = 0;	// Characters of BOOT_MAGIC received so far
+
+	__asm__ __volatile__("clr __zero_reg__");
+
+	// A reset by the firmware (see startBootloader()) leaves the watchdog on
+	MCUSR = 0;
+	wdt_disable();
+
+	UBRR0H = (unsigned char)((F_CPU/(16UL*BAUD)-1)>>8);
+	UBRR0L = (unsigned char)(F_CPU/(16UL*BAUD)-1);
+	UCSR0B = (1<<RXEN0) | (1<<TXEN0);
+	TCCR1B = (1<<CS12) | (1<<CS10);
+
+	for(;;)
+	{
+		// Timer1 wraps after 4 s, long after the wait is over
+		if(!synced && TCNT1 >= BOOT_WAIT && firmwarePresent())
+		{
+			startFirmware();
+		}
+
+		int command = readByte(BYTE_TIMEOUT);
+
+		if(command < 0)
+		{
+			matched = 0;
+			continue;
+		}
+
+		// BOOT_MAGIC starts over at any character that breaks it. Its
+		// characters are not commands, so they need not go further.
+		if(command == pgm_read_byte(&bootMagic[matched]))
+		{
+			if(++matched == sizeof(bootMagic) - 1)
+			{
+				matched = 0;
+				synced = TRUE;
+				writeByte('!');
+				writeByte('B');
+				writeByte(BOOT_PAGES);
+			}
+			continue;
+		}
+		matched = (command == pgm_read_byte(&bootMagic[0]));
+
+		if(!synced)
+		{
+			continue;
+		}
+
+		if(command == 'C')
+		{
+			int first = readByte(BYTE_TIMEOUT);
+			int count = readByte(BYTE_TIMEOUT);
+
+			if(first >= 0 && count >= 0)
+			{
+				writeByte('C');
+				for(; count > 0; first++, count--)
+				{
+					unsigned int crc = first < BOOT_PAGES ? pageCrc(first * SPM_PAGESIZE) : 0;
+
+					writeByte(crc & 0xFF);
+					writeByte(crc >> 8);
+				}
+			}
+		}
+		else if(command == 'W')
+		{
+			unsigned char reply = writePage();
+
+			if(reply)
+			{
+				writeByte(reply);
+			}
+		}
+		else if(command == 'X')
+		{
+			// A stray 'X' in the middle of an update finds page 0 erased
+			if(firmwarePresent())
+			{
+				writeByte('X');
+				while(!(UCSR0A & (1 << TXC0)))
+				{
+				}
+				startFirmware();
+			}
+			writeByte('E');
+		}
+	}
+}
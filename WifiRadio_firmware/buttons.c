@@ -0,0 +1,50 @@
+/*
+ * The buttons of the radio, see buttons.h
+ */
+
+//=========== Includes ===========
+
+#include "buttons.h"
+
+//=========== Local variables ===========
+
+static unsigned char buttonPressSeen;	// Bits used to keep track of which button presses have been seen
+
+//=========== Public functions ===========
+
+// Make the button pins inputs with pull-ups
+void buttonInit(void)
+{
+	DDRB  &= 0b11111000; // PB0, 1, 2 are input
+	PORTB |= 0b00000111; // Enable internal pull-up resistors	
+
+	DDRD  &= 0b00011111; // PB5, 6, 7 are input
+	PORTD |= 0b11100000; // Enable internal pull-up resistors
+}
+
+// Handle a button press. This returns TRUE when a new button press on the selected pin is detected 
+// Once a button press is detected, the function returns FALSE, until the button is released and 
+// pressed again
+BOOL processButtonPress(int buttonIndex, int buttonPin)
+{
+	BOOL result = FALSE;
+	
+	if(!(buttonPressSeen & (1 << buttonIndex)))
+	{
+		if(!(buttonPin))
+		{
+			buttonPressSeen |=  (1 << buttonIndex);
+			result=TRUE;
+		}
+	}
+	else
+	{
+		if((buttonPin))
+		{
+			buttonPressSeen &=  ~(1 << buttonIndex);
+		}
+		
+	}
+	
+	return result;
+}
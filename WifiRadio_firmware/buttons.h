@@ -0,0 +1,30 @@
+/*
+ * The six buttons of the radio. They pull their pin low when pressed; a press
+ * is reported once, when the button goes down.
+ */
+
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <avr/io.h>
+
+#include "common.h"
+
+#define UPBUTTON 0
+#define DOWNBUTTON 1
+#define LEFTBUTTON 2
+#define RIGHTBUTTON 3
+#define ENTERBUTTON 4
+#define SWITCHBUTTON 5
+
+#define UPBUTTONPIN PINB&4
+#define DOWNBUTTONPIN PIND&128
+#define LEFTBUTTONPIN PINB&2
+#define RIGHTBUTTONPIN PIND&32
+#define ENTERBUTTONPIN PIND&64
+#define SWITCHBUTTONPIN PINB&1
+
+void buttonInit(void);
+BOOL processButtonPress(int buttonIndex, int buttonPin);
+
+#endif
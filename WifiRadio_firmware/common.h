@@ -0,0 +1,35 @@
+/*
+ * Definitions shared between the firmware modules
+ */
+
+#ifndef COMMON_H
+#define COMMON_H
+
+#define STR_LEN			21		// Longest substring (artist, trackname) to accept. Width of the display + terminating 0
+#define	LCD_WIDTH		20		// visible width of LCD display
+
+#define BOOL unsigned char
+#define TRUE 1
+#define FALSE 0
+
+// Constant strings live in flash on the AVR. The host build of the parsers
+// (e.g. for fuzzing) has a single address space, so the _P functions map
+// onto their plain counterparts there.
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define PGM_P					const char *
+#define PSTR(s)					(s)
+#define pgm_read_byte(addr)		(*(const unsigned char *)(addr))
+#define pgm_read_word(addr)		(*(addr))
+#define strstr_P				strstr
+#define strlen_P				strlen
+#define memcmp_P				memcmp
+#define strncmp_P				strncmp
+#define strcmp_P				strcmp
+#define strcpy_P				strcpy
+#define strncpy_P				strncpy
+#endif
+
+#endif
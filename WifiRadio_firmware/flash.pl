@@ -0,0 +1,260 @@
+#!/usb/packages/usr/bin/perl -w
+
+# Updates the firmware over the serial line, through the bootloader (see
+# bootloader.c). Stop interface.pl first, as both would read the serial port.
+#
+# The running firmware is asked to reset into the bootloader, which answers
+# once it gets $bootMagic (BOOT_MAGIC in bootloader.c), and is then asked for
+# the CRC of every flash page. Only the pages whose CRC differs from
+# the new firmware are sent, so an update that changes a few pages takes a
+# few seconds. A change in the code moves everything linked after it, though,
+# which then all has to be written: about 7 pages (0.9 KB) per second at 9600
+# baud.
+#
+# Page 0, with the reset vector, is erased before any other page is written and
+# written last, so the bootloader does not start an incomplete firmware if the
+# update is interrupted; running flash.pl again finishes it.
+#
+# Usage: flash.pl [--tty /dev/tts/1] [--wait 10] [--force] [--check] main.hex
+#
+# --force writes every page, --check only reports how many pages differ. Point
+# --tty at /tmp/simavr-uart0 to update the bootloader running in simavr (see
+# the sim-bootloader target in the Makefile).
+
+use strict;
+use Getopt::Long;
+use Time::HiRes qw(time sleep);
+
+my $tty = "/dev/tts/1";
+my $stty = $ENV{STTY} || "/usb/packages/usr/bin/stty";
+my $wait = 10;                  # seconds to wait for the bootloader to answer
+my $force = 0;
+my $check = 0;
+my $pageSize = 128;             # SPM_PAGESIZE of the ATmega328
+my $tries = 3;                  # attempts per command before giving up
+my $bootMagic = "\x1BBOOT\x1B";  # makes the bootloader take commands
+
+GetOptions("tty=s" => \$tty, "wait=f" => \$wait, "force" => \$force, "check" => \$check)
+    or die "Invalid options\n";
+my $hexFile = shift(@ARGV) or die "Usage: flash.pl [--tty device] [--wait seconds] [--force] [--check] file.hex\n";
+
+#=========== Firmware image ===========
+
+# Read an Intel HEX file into a list of pages of $pageSize bytes. Bytes the
+# file does not set are left erased (0xFF).
+sub readHex($)
+{
+    my ($file) = @_;
+    my @image = ();
+    my $base = 0;
+
+    open(HEX, "<", $file) or die "Cannot open $file: $!\n";
+    while(<HEX>)
+    {
+        s/\s+$//;
+        next if $_ eq "";
+        my ($record) = /^:((?:[0-9A-Fa-f]{2})+)$/ or die "$file:$.: not an Intel HEX record\n";
+        my @bytes = map { hex } unpack("(A2)*", $record);
+        my $sum = 0;
+        $sum += $_ for @bytes;
+        die "$file:$.: checksum error\n" if $sum & 0xFF;
+        my ($length, $addressHigh, $addressLow, $type) = @bytes;
+        die "$file:$.: wrong length\n" unless @bytes == $length + 5;
+
+        if($type == 0)
+        {
+            my $address = $base + $addressHigh * 256 + $addressLow;
+            @image[$address .. $address + $length - 1] = @bytes[4 .. $length + 3];
+        }
+        elsif($type == 1)
+        {
+            last;
+        }
+        elsif($type == 2)
+        {
+            $base = ($bytes[4] * 256 + $bytes[5]) << 4;
+        }
+        elsif($type == 4)
+        {
+            $base = ($bytes[4] * 256 + $bytes[5]) << 16;
+        }
+        # Start addresses (3 and 5) do not matter here
+    }
+    close(HEX);
+
+    my @pages = ();
+    for(my $address = 0; $address < @image; $address += $pageSize)
+    {
+        push(@pages, pack("C*", map { defined $_ ? $_ : 0xFF } @image[$address .. $address + $pageSize - 1]));
+    }
+    return @pages;
+}
+
+# CRC16 as computed by _crc16_update() in avr-libc
+sub crc16($)
+{
+    my $crc = 0xFFFF;
+
+    for my $byte (unpack("C*", $_[0]))
+    {
+        $crc ^= $byte;
+        for (1 .. 8)
+        {
+            $crc = $crc & 1 ? ($crc >> 1) ^ 0xA001 : $crc >> 1;
+        }
+    }
+    return $crc;
+}
+
+#=========== Serial line ===========
+
+my $savedStty = `$stty -g < $tty`;
+die "Cannot read the settings of $tty\n" if $?;
+chomp($savedStty);
+system("$stty 9600 raw -echo < $tty") == 0 or die "Cannot set up $tty\n";
+END { system("$stty $savedStty < $tty") if defined $savedStty and $savedStty ne ""; }
+
+open(TTY, "+<", $tty) or die "Cannot open $tty: $!\n";
+binmode(TTY);
+
+sub sendBytes($)
+{
+    my ($data) = @_;
+    syswrite(TTY, $data) == length($data) or die "Cannot write to $tty: $!\n";
+}
+
+# Read up to the given number of bytes, for at most the given number of
+# seconds. Returns what came in.
+sub receiveBytes($$)
+{
+    my ($length, $timeout) = @_;
+    my $data = "";
+    my $deadline = time() + $timeout;
+
+    while(length($data) < $length)
+    {
+        my $left = $deadline - time();
+        last if $left <= 0;
+        my $bits = "";
+        vec($bits, fileno(TTY), 1) = 1;
+        next unless select($bits, undef, undef, $left);
+        last unless sysread(TTY, $data, $length - length($data), length($data));
+    }
+    return $data;
+}
+
+# Discard whatever is still coming in. A pause longer than the bootloader's
+# timeout within a command also makes it drop a command that got garbled.
+sub drain()
+{
+    while(receiveBytes(1024, 0.3) ne "")
+    {
+    }
+}
+
+# Time to receive a reply of the given length, with some slack
+sub replyTime($)
+{
+    return 0.5 + $_[0] * 10 / 9600;
+}
+
+#=========== Bootloader commands ===========
+
+# Get the firmware to reset into the bootloader, and wait until it answers.
+# Returns the number of pages the firmware may use.
+sub connectBootloader()
+{
+    my $deadline = time() + $wait;
+    my $nextRequest = 0;
+    my $received = "";
+
+    while(time() < $deadline)
+    {
+        # The firmware may have half a line in its buffer, hence the newline
+        # in front. The bootloader ignores all of this, and the firmware the
+        # magic.
+        if(time() >= $nextRequest)
+        {
+            sendBytes("\nbootloader\n");
+            $nextRequest = time() + 1;
+        }
+        sendBytes($bootMagic);
+        $received .= receiveBytes(1024, 0.1);
+        if($received =~ /!B(.)/s)
+        {
+            drain();    # answers to the magic sent before
+            return ord($1);
+        }
+    }
+    die "No answer from the bootloader on $tty\n";
+}
+
+sub pageCrcs($)
+{
+    my ($count) = @_;
+
+    for (1 .. $tries)
+    {
+        sendBytes(pack("aCC", "C", 0, $count));
+        my $reply = receiveBytes(1 + 2 * $count, replyTime(1 + 2 * $count));
+        return unpack("v*", substr($reply, 1)) if length($reply) == 1 + 2 * $count and substr($reply, 0, 1) eq "C";
+        drain();
+    }
+    die "Cannot read the page CRCs\n";
+}
+
+sub writePage($$)
+{
+    my ($page, $data) = @_;
+
+    for (1 .. $tries)
+    {
+        sendBytes(pack("aC", "W", $page).$data.pack("v", crc16($data)));
+        my $reply = receiveBytes(1, replyTime($pageSize + 4));
+        return if $reply eq "K";
+        print "Page $page: ".($reply eq "E" ? "error" : "no answer").", trying again\n";
+        drain();
+    }
+    die "Cannot write page $page\n";
+}
+
+sub startFirmware()
+{
+    for (1 .. $tries)
+    {
+        sendBytes("X");
+        my $reply = receiveBytes(1, replyTime(1));
+        return if $reply eq "X";
+        die "The firmware is incomplete, not started\n" if $reply eq "E";
+        drain();
+    }
+    die "Cannot start the firmware\n";
+}
+
+#=========== Main ===========
+
+my @pages = readHex($hexFile);
+my $start = time();
+my $bootPages = connectBootloader();
+
+die sprintf("%s takes %d pages, only %d fit next to the bootloader\n", $hexFile, scalar(@pages), $bootPages)
+    if @pages > $bootPages;
+
+my @crcs = pageCrcs(scalar(@pages));
+my @changed = grep { $force or crc16($pages[$_]) != $crcs[$_] } 0 .. $#pages;
+
+printf("%s: %d of %d pages differ\n", $hexFile, scalar(@changed), scalar(@pages));
+
+if(!$check and @changed)
+{
+    # Page 0 goes last, and until then the firmware counts as absent
+    my @order = grep { $_ != 0 } @changed;
+    if(@order)
+    {
+        writePage(0, "\xFF" x $pageSize);
+    }
+    writePage($_, $pages[$_]) for (@order, 0);
+}
+
+startFirmware();
+printf("Done in %.1f s\n", time() - $start);
@@ -0,0 +1,103 @@
+/*
+ * Small, specialised number formatters, see format.h
+ */
+
+//=========== Includes ===========
+
+#include "format.h"
+
+//=========== Local functions ===========
+
+// Append a zero-terminated string from flash to dest
+static char *appendString_P(char *dest, PGM_P s)
+{
+	char c;
+
+	while((c = pgm_read_byte(s++)))
+	{
+		*dest++ = c;
+	}
+	*dest = '\0';
+
+	return dest;
+}
+
+//=========== Public functions ===========
+
+// Unsigned decimal, without leading zeroes ("%u")
+char *formatNumber(char *dest, unsigned int value)
+{
+	char digits[FORMAT_NUMBER_LEN - 1];
+	unsigned char numDigits = 0;
+
+	// Generate the digits least significant first, then copy them in reverse
+	do
+	{
+		digits[numDigits++] = '0' + value % 10;
+		value /= 10;
+	} while(value);
+
+	while(numDigits)
+	{
+		*dest++ = digits[--numDigits];
+	}
+	*dest = '\0';
+
+	return dest;
+}
+
+// Elapsed time as minutes and seconds ("%u:%02u")
+char *formatTime(char *dest, unsigned int seconds)
+{
+	unsigned int minutes = seconds / 60;
+	unsigned char remainder = seconds - minutes * 60;
+
+	dest = formatNumber(dest, minutes);
+	*dest++ = ':';
+	*dest++ = '0' + remainder / 10;
+	*dest++ = '0' + remainder % 10;
+	*dest = '\0';
+
+	return dest;
+}
+
+// Position in the playlist ("(%u of %u)")
+char *formatPosition(char *dest, unsigned int num, unsigned int total)
+{
+	*dest++ = '(';
+	dest = formatNumber(dest, num);
+	dest = appendString_P(dest, PSTR(" of "));
+	dest = formatNumber(dest, total);
+	*dest++ = ')';
+	*dest = '\0';
+
+	return dest;
+}
+
+// Command with two parameters for the router ("cmd:%S %u %u\n", verb in flash)
+char *formatCommand(char *dest, PGM_P verb, unsigned int param1, unsigned int param2)
+{
+	dest = appendString_P(dest, PSTR("cmd:"));
+	dest = appendString_P(dest, verb);
+	*dest++ = ' ';
+	dest = formatNumber(dest, param1);
+	*dest++ = ' ';
+	dest = formatNumber(dest, param2);
+	*dest++ = '\n';
+	*dest = '\0';
+
+	return dest;
+}
+
+// Command with one parameter for the router ("cmd:%S %u\n", verb in flash)
+char *formatCommandParam(char *dest, PGM_P verb, unsigned int param)
+{
+	dest = appendString_P(dest, PSTR("cmd:"));
+	dest = appendString_P(dest, verb);
+	*dest++ = ' ';
+	dest = formatNumber(dest, param);
+	*dest++ = '\n';
+	*dest = '\0';
+
+	return dest;
+}
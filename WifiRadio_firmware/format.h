@@ -0,0 +1,22 @@
+/*
+ * Small, specialised number formatters for the display and the command
+ * path. They replace sprintf(), so vfprintf is not linked into the image.
+ *
+ * Every formatter writes a zero-terminated string to dest and returns a
+ * pointer to the terminating zero, so calls can be chained.
+ */
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "common.h"
+
+#define FORMAT_NUMBER_LEN	6	// Longest formatted number ("65535") + terminating 0
+
+char *formatNumber(char *dest, unsigned int value);
+char *formatTime(char *dest, unsigned int seconds);
+char *formatPosition(char *dest, unsigned int num, unsigned int total);
+char *formatCommand(char *dest, PGM_P verb, unsigned int param1, unsigned int param2);
+char *formatCommandParam(char *dest, PGM_P verb, unsigned int param);
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ * Manager for the custom characters of the LCD, see glyph.h
+ */
+
+//=========== Includes ===========
+
+#include <avr/io.h>
+
+#include "lcd.h"
+#include "glyph.h"
+
+//=========== Defines ===========
+
+#define	NUM_SLOTS		8		// User defined characters in the HD44780 CGRAM
+#define	GLYPH_ROWS		8		// Pixel rows per character
+#define	GLYPH_NONE		0xFF	// Slot holds no known glyph
+#define	BIG_COLON		((char)0xA5)	// Centered dot from the character ROM, used twice for a big colon
+
+//=========== Local variables ===========
+
+// Pixel rows of each glyph, top row first, 5 least significant bits used
+static const uint8_t glyphRows[NUM_GLYPHS][GLYPH_ROWS] PROGMEM =
+{
+	{ 0x08, 0x0C, 0x0E, 0x0F, 0x0E, 0x0C, 0x08, 0x00 },	// GLYPH_PLAY
+	{ 0x1B, 0x1B, 0x1B, 0x1B, 0x1B, 0x1B, 0x1B, 0x00 },	// GLYPH_PAUSE
+	{ 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x00, 0x00 },	// GLYPH_STOP
+	{ 0x0E, 0x11, 0x04, 0x0A, 0x00, 0x04, 0x04, 0x0E },	// GLYPH_STREAM
+	{ 0x04, 0x0E, 0x1F, 0x04, 0x04, 0x04, 0x00, 0x00 },	// GLYPH_ARROW_UP
+	{ 0x00, 0x00, 0x04, 0x04, 0x04, 0x1F, 0x0E, 0x04 },	// GLYPH_ARROW_DOWN
+	{ 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },	// GLYPH_BAR_0
+	{ 0x1F, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },	// GLYPH_BAR_1
+	{ 0x1F, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1F },	// GLYPH_BAR_2
+	{ 0x1F, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1F },	// GLYPH_BAR_3
+	{ 0x1F, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1F },	// GLYPH_BAR_4
+	{ 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00 },	// GLYPH_BIG_TOP
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F },	// GLYPH_BIG_BOTTOM
+	{ 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F },	// GLYPH_BIG_BOTH
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },	// GLYPH_VBAR_1
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F },	// GLYPH_VBAR_1 + 1
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F },	// GLYPH_VBAR_1 + 2
+	{ 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F, 0x1F },	// GLYPH_VBAR_1 + 3
+	{ 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F },	// GLYPH_VBAR_1 + 4
+	{ 0x00, 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F },	// GLYPH_VBAR_6
+	{ 0x02, 0x04, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00 },	// GLYPH_TEXT_0 + 0: e acute
+	{ 0x08, 0x04, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00 },	// GLYPH_TEXT_0 + 1: e grave
+	{ 0x04, 0x0A, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00 },	// GLYPH_TEXT_0 + 2: e circumflex
+	{ 0x02, 0x04, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00 },	// GLYPH_TEXT_0 + 3: a acute
+	{ 0x08, 0x04, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00 },	// GLYPH_TEXT_0 + 4: a grave
+	{ 0x04, 0x0A, 0x04, 0x0E, 0x01, 0x0F, 0x11, 0x0F },	// GLYPH_TEXT_0 + 5: a ring
+	{ 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E, 0x04, 0x0C },	// GLYPH_TEXT_0 + 6: c cedilla
+	{ 0x00, 0x01, 0x0E, 0x13, 0x15, 0x19, 0x0E, 0x10 },	// GLYPH_TEXT_0 + 7: o slash
+};
+
+// What to show instead when all slots are pinned (should not happen, but the
+// display should stay readable if it does)
+static const char glyphFallback[NUM_GLYPHS] PROGMEM =
+{
+	'>', '|', '#', '*', '^', 'v', '-', '-', '-', '#', '#', '-', '_', '=',
+	'_', '_', '-', '-', '=', '=',
+	'e', 'e', 'e', 'a', 'a', 'a', 'c', 'o'
+};
+
+// Big digits, 3 characters wide and 2 lines high. T(op), B(ottom) and
+// M (both) are the custom segment glyphs, F the full block from the ROM.
+static const char bigDigits[10][2 * GLYPH_BIG_WIDTH] PROGMEM =
+{
+	{ 'F','T','F', 'F','B','F' },	// 0
+	{ 'T','F',' ', 'B','F','B' },	// 1
+	{ 'M','M','F', 'F','B','B' },	// 2
+	{ 'M','M','F', 'B','B','F' },	// 3
+	{ 'F','B','F', ' ',' ','F' },	// 4
+	{ 'F','M','M', 'B','B','F' },	// 5
+	{ 'F','M','M', 'F','B','F' },	// 6
+	{ 'T','T','F', ' ',' ','F' },	// 7
+	{ 'F','M','F', 'F','B','F' },	// 8
+	{ 'F','M','F', 'B','B','F' },	// 9
+};
+
+static unsigned char slotGlyph[NUM_SLOTS] =		// Glyph assigned to each slot
+	{ GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE };
+static unsigned char slotLoaded[NUM_SLOTS] =	// Glyph actually in CGRAM, differs from slotGlyph until glyphFlush()
+	{ GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE };
+static unsigned int slotLastUse[NUM_SLOTS];		// Value of useClock when the slot was last asked for
+static unsigned int useClock;					// Counts glyphGet() calls, for the LRU replacement
+static unsigned char linePins[LCD_LINES];		// Per display line, a bit for each slot that line shows
+
+//=========== Local functions ===========
+
+// Character code that shows the given slot. Slot 0 is also available as
+// character 8, which keeps it out of the way of the string terminator.
+static char slotChar(unsigned char slot)
+{
+	return slot ? slot : 8;
+}
+
+// Look up one segment of a big digit
+static char bigSegment(char segment, unsigned char line)
+{
+	switch(segment)
+	{
+		case 'T':	return glyphGet(GLYPH_BIG_TOP, line);
+		case 'B':	return glyphGet(GLYPH_BIG_BOTTOM, line);
+		case 'M':	return glyphGet(GLYPH_BIG_BOTH, line);
+		case 'F':	return GLYPH_FULL_BLOCK;
+		default:	return ' ';
+	}
+}
+
+//=========== Public functions ===========
+
+// Forget which glyphs are on one line of the display, before redrawing it
+void glyphClearLine(unsigned char line)
+{
+	linePins[line] = 0;
+}
+
+// Return the character code that shows the given glyph, assigning it a slot
+// if it does not have one yet. The glyph is pinned to the given line until
+// that line is cleared. Call glyphFlush() once the display has been drawn.
+char glyphGet(unsigned char glyph, unsigned char line)
+{
+	unsigned char pinned = 0;
+	unsigned char slot = NUM_SLOTS;
+	unsigned int oldestAge = 0;
+
+	for(unsigned char i=0; i<LCD_LINES; i++)
+	{
+		pinned |= linePins[i];
+	}
+
+	for(unsigned char i=0; i<NUM_SLOTS; i++)
+	{
+		if(slotGlyph[i] == glyph)
+		{
+			slot = i;
+			break;
+		}
+
+		// Replacement candidate: an unused slot, or else the unpinned slot that
+		// was least recently asked for
+		if(!(pinned & (1 << i)))
+		{
+			unsigned int age = slotGlyph[i] == GLYPH_NONE ? 0xFFFF : useClock - slotLastUse[i];
+			if(slot == NUM_SLOTS || age > oldestAge)
+			{
+				slot = i;
+				oldestAge = age;
+			}
+		}
+	}
+
+	if(slot == NUM_SLOTS)
+	{
+		return pgm_read_byte(&glyphFallback[glyph]);
+	}
+
+	slotGlyph[slot] = glyph;
+	slotLastUse[slot] = ++useClock;
+	linePins[line] |= 1 << slot;
+
+	return slotChar(slot);
+}
+
+// Write the glyphs assigned since the last call into CGRAM. For each slot,
+// only the run of pixel rows that differs from its previous glyph is written.
+void glyphFlush(void)
+{
+	for(unsigned char slot=0; slot<NUM_SLOTS; slot++)
+	{
+		unsigned char glyph = slotGlyph[slot];
+		unsigned char old = slotLoaded[slot];
+
+		if(glyph == old || glyph == GLYPH_NONE)
+		{
+			continue;
+		}
+
+		unsigned char first = 0;
+		unsigned char last = GLYPH_ROWS - 1;
+
+		if(old != GLYPH_NONE)
+		{
+			while(first < GLYPH_ROWS && pgm_read_byte(&glyphRows[glyph][first]) == pgm_read_byte(&glyphRows[old][first]))
+			{
+				first++;
+			}
+			while(last > first && pgm_read_byte(&glyphRows[glyph][last]) == pgm_read_byte(&glyphRows[old][last]))
+			{
+				last--;
+			}
+		}
+
+		if(first < GLYPH_ROWS)
+		{
+			lcd_cgram_p(slot * GLYPH_ROWS + first, &glyphRows[glyph][first], last - first + 1);
+		}
+		slotLoaded[slot] = glyph;
+	}
+}
+
+// Copy text to dest, replacing the text glyph codes the router uses for
+// letters the character ROM lacks by the characters that show them. The
+// glyphs are pinned to the given line. Returns the end of dest.
+char *glyphText(char *dest, const char *text, unsigned char line)
+{
+	for(; *text; text++)
+	{
+		unsigned char c = *text;
+
+		if(c >= GLYPH_TEXT_CODE && c < GLYPH_TEXT_CODE + NUM_TEXT_GLYPHS)
+		{
+			*dest++ = glyphGet(GLYPH_TEXT_0 + c - GLYPH_TEXT_CODE, line);
+		}
+		else
+		{
+			*dest++ = c;
+		}
+	}
+	*dest = '\0';
+
+	return dest;
+}
+
+// Render text consisting of digits and colons in big characters, on two lines
+// starting at the given display line. The upper and lower halves are written to
+// the upper and lower buffers, which must hold 4 characters per digit plus 2
+// per colon. Other characters become a single space. Returns the end of upper.
+char *glyphBigText(char *upper, char *lower, const char *text, unsigned char line)
+{
+	for(; *text; text++)
+	{
+		if(*text >= '0' && *text <= '9')
+		{
+			PGM_P segments = bigDigits[*text - '0'];
+
+			for(unsigned char i=0; i<GLYPH_BIG_WIDTH; i++)
+			{
+				*upper++ = bigSegment(pgm_read_byte(&segments[i]), line);
+				*lower++ = bigSegment(pgm_read_byte(&segments[GLYPH_BIG_WIDTH + i]), line + 1);
+			}
+		}
+		else if(*text == ':')
+		{
+			*upper++ = BIG_COLON;
+			*lower++ = BIG_COLON;
+		}
+		else
+		{
+			*upper++ = ' ';
+			*lower++ = ' ';
+			continue;
+		}
+
+		// Spacing between characters
+		if(text[1])
+		{
+			*upper++ = ' ';
+			*lower++ = ' ';
+		}
+	}
+
+	*upper = '\0';
+	*lower = '\0';
+
+	return upper;
+}
@@ -0,0 +1,54 @@
+/*
+ * Manager for the custom characters of the LCD.
+ *
+ * The HD44780 has room for 8 user defined characters in its CGRAM, while the
+ * firmware knows more glyphs than that (icons, progress bar cells, big digit
+ * segments). Glyphs are loaded into the 8 slots on demand, the least recently
+ * used slot being replaced when all of them are taken.
+ *
+ * A glyph that is on the display must not be replaced, so every glyph is
+ * pinned to the display line(s) it is drawn on until glyphClearLine() is
+ * called for that line, which screenClearLine() does before a line is
+ * composed again. New glyphs are only written to CGRAM by glyphFlush(), and
+ * then only the pixel rows that differ from what the slot held before.
+ */
+
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include "common.h"
+
+// Glyphs known to the firmware
+#define GLYPH_PLAY			0
+#define GLYPH_PAUSE			1
+#define GLYPH_STOP			2
+#define GLYPH_STREAM		3
+#define GLYPH_ARROW_UP		4
+#define GLYPH_ARROW_DOWN	5
+#define GLYPH_BAR_0			6		// Progress bar cell with 0..4 of its 5 pixel columns filled.
+#define GLYPH_BAR_1			7		// A completely filled cell is the ROM character GLYPH_FULL_BLOCK.
+#define GLYPH_BAR_2			8
+#define GLYPH_BAR_3			9
+#define GLYPH_BAR_4			10
+#define GLYPH_BIG_TOP		11		// Segments for the big digits of glyphBigText()
+#define GLYPH_BIG_BOTTOM	12
+#define GLYPH_BIG_BOTH		13
+#define GLYPH_VBAR_1		14		// Spectrum bar with 1..6 of its 8 pixel rows filled, from the bottom.
+#define GLYPH_VBAR_6		19		// 0 rows is a space, 7 levels the ROM character GLYPH_FULL_BLOCK.
+#define GLYPH_TEXT_0		20		// Accented letters without a match in the character ROM,
+#define NUM_TEXT_GLYPHS		8		// sent by the router as GLYPH_TEXT_CODE + n, see interface.pl
+#define NUM_GLYPHS			(GLYPH_TEXT_0 + NUM_TEXT_GLYPHS)
+
+#define GLYPH_TEXT_CODE		0x10	// Character code the router uses for text glyph 0
+
+#define GLYPH_FULL_BLOCK	((char)0xFF)	// All pixels on, from the character ROM
+#define GLYPH_BAR_STEPS		5				// Pixel columns per progress bar cell
+#define GLYPH_BIG_WIDTH		3				// Width of a big digit, in characters
+
+void glyphClearLine(unsigned char line);
+char glyphGet(unsigned char glyph, unsigned char line);
+void glyphFlush(void);
+char *glyphText(char *dest, const char *text, unsigned char line);
+char *glyphBigText(char *upper, char *lower, const char *text, unsigned char line);
+
+#endif
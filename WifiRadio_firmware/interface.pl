@@ -1,17 +1,135 @@
 #!/usb/packages/usr/bin/perl -w
 
-system("/usb/packages/usr/bin/stty 9600 -echo < /dev/tts/1");
+# MPD connection and mpc binary. MPD_HOST and MPD_PORT are also honoured by mpc
+# itself, so pointing both at mpdstub.pl runs everything without a real MPD.
+$mpdHost = $ENV{MPD_HOST} || "localhost";
+$mpdPort = $ENV{MPD_PORT} || 6600;
+$mpc = $ENV{MPC} || "./mpc";
+
+use IO::Socket::INET;
+use Time::HiRes;
+use POSIX qw(WNOHANG);
+
+# Serial port the AVR is connected to. Pass a different device (e.g. one end
+# of a pty pair) as the first argument to run against something else.
+$tty = $ARGV[0] || "/dev/tts/1";
+$stty = $ENV{STTY} || "/usb/packages/usr/bin/stty";
+
+system("$stty 9600 -echo < $tty");
+
+# Character ROM of the display: A00 (Japanese, as on the Sparkfun display) or
+# A02 (European).
+$lcdRom = $ENV{LCD_ROM} || "A00";
+
+# MPD sends UTF-8, while the display shows one byte per cell from its
+# character ROM. %lcdMap translates characters outside plain ASCII (and the
+# two ASCII characters the A00 ROM replaces) into the bytes that show them,
+# so every byte sent to the AVR is exactly one cell. Letters without a ROM
+# match that are common in titles are sent as 0x10..0x17, for which the
+# firmware loads custom characters (see GLYPH_TEXT_CODE in glyph.h); the
+# rest are transliterated. Characters missing from the table become '?'.
+%lcdMap = ();
+
+sub lcdMapChars($@)
+{
+    my ($from, @to) = @_;
+    
+    foreach my $c (split(//, $from))
+    {
+        $lcdMap{$c} = shift(@to) unless exists $lcdMap{$c};
+    }
+}
+
+if($lcdRom eq "A02")
+{
+    # The upper half of the A02 ROM follows ISO-8859-1
+    lcdMapChars(join("", map { chr($_) } 0xA0..0xFF), map { chr($_) } 0xA0..0xFF);
+}
+else
+{
+    # Characters in the A00 ROM
+    lcdMapChars("\x{E4}\x{F6}\x{FC}\x{DF}\x{F1}\x{B0}\x{B5}\x{B7}\x{A2}\x{A3}\x{A5}\x{F7}\x{3B1}\x{3B2}\x{3B5}\x{3C3}\x{3C1}\x{3B8}\x{3C0}\x{3A3}\x{3A9}\x{221E}\x{2192}\x{2190}",
+                "\xE1", "\xEF", "\xF5", "\xE2", "\xEE", "\xDF", "\xE4", "\xA5", "\xEC", "\xED", "\x5C", "\xFD", "\xE0", "\xE2", "\xE3", "\xE5", "\xE6", "\xF2", "\xF7", "\xF6", "\xF4", "\xF3", "\x7E", "\x7F");
+    # 0x5C and 0x7E show a Yen sign and an arrow
+    lcdMapChars("\\~", qw(/ -));
+    # Custom characters
+    lcdMapChars("\x{E9}\x{E8}\x{EA}\x{E1}\x{E0}\x{E5}\x{E7}\x{F8}",
+                "\x10", "\x11", "\x12", "\x13", "\x14", "\x15", "\x16", "\x17");
+    # Transliterations for the rest of ISO-8859-1
+    lcdMapChars("\x{C0}\x{C1}\x{C2}\x{C3}\x{C4}\x{C5}\x{C6}\x{C7}\x{C8}\x{C9}\x{CA}\x{CB}\x{CC}\x{CD}\x{CE}\x{CF}",
+                qw(A A A A A A AE C E E E E I I I I));
+    lcdMapChars("\x{D0}\x{D1}\x{D2}\x{D3}\x{D4}\x{D5}\x{D6}\x{D7}\x{D8}\x{D9}\x{DA}\x{DB}\x{DC}\x{DD}\x{DE}",
+                qw(D N O O O O O x O U U U U Y Th));
+    lcdMapChars("\x{E2}\x{E3}\x{E6}\x{EB}\x{EC}\x{ED}\x{EE}\x{EF}\x{F0}\x{F2}\x{F3}\x{F4}\x{F5}\x{F9}\x{FA}\x{FB}\x{FD}\x{FE}\x{FF}",
+                qw(a a ae e i i i i d o o o o u u u y th y));
+    lcdMapChars("\x{A0}\x{A1}\x{A9}\x{AB}\x{AE}\x{BB}\x{BF}",
+                "\x20", "!", "(c)", "<", "(R)", ">", "?");
+}
+
+# Transliterations beyond ISO-8859-1, for both ROMs
+lcdMapChars("\x{100}\x{101}\x{106}\x{107}\x{10C}\x{10D}\x{110}\x{111}\x{118}\x{119}\x{11B}\x{11E}\x{11F}\x{130}\x{131}\x{141}\x{142}\x{143}\x{144}",
+            qw(A a C c C c D d E e e G g I i L l N n));
+lcdMapChars("\x{147}\x{148}\x{150}\x{151}\x{152}\x{153}\x{158}\x{159}\x{15A}\x{15B}\x{15E}\x{15F}\x{160}\x{161}\x{16E}\x{16F}\x{170}\x{171}\x{178}\x{179}\x{17A}\x{17B}\x{17C}\x{17D}\x{17E}",
+            qw(N n O o OE oe R r S s S s S s U u U u Y Z z Z z Z z));
+lcdMapChars("\x{2010}\x{2013}\x{2014}\x{2018}\x{2019}\x{201C}\x{201D}\x{2026}",
+            "-", "-", "-", "'", "'", "\"", "\"", "...");
+
+# Translate a string from MPD into bytes for the display
+sub toLcd($)
+{
+    my ($text) = @_;
+    my $result = "";
+    
+    # Tags that are not valid UTF-8 are most likely ISO-8859-1, which is what
+    # the string holds if decoding fails
+    utf8::decode($text);
+    
+    foreach my $c (split(//, $text))
+    {
+        if(exists $lcdMap{$c})
+        {
+            $result .= $lcdMap{$c};
+        }
+        elsif(ord($c) >= 0x20 and ord($c) < 0x7F)
+        {
+            $result .= $c;
+        }
+        else
+        {
+            $result .= "?";
+        }
+    }
+    
+    utf8::downgrade($result);
+    return $result;
+}
+
+# Going down into a directory keeps a breadcrumb of the parent: where the AVR
+# was in its listing, and the page it was shown. The AVR keeps the same
+# breadcrumbs (see enterDirectory() in main.c) and shows its own copy again on
+# the way back up, so then only @currentDir changes here. The page of the
+# last breadcrumb taken becomes $lastPage, the page a repeated request is
+# answered from without asking mpc.
+@breadcrumbs = ();
+$lastPage = undef;
 
 sub sendTracks($$)
 {
     ($currentDir, $currentListStartIndex) = @_;
     
-    $currentListStartIndex += 4;
-        
-    $cmd = "./mpc ls $currentDir | head -n $currentListStartIndex | tail -n 4";
-    @trackList = `$cmd`;
+    if(defined $lastPage and $lastPage->{dir} eq $currentDir and $lastPage->{start} == $currentListStartIndex)
+    {
+        @trackList = @{$lastPage->{entries}};
+    }
+    else
+    {
+        $end = $currentListStartIndex + 4;
+        $cmd = "$mpc ls $currentDir | head -n $end | tail -n 4";
+        @trackList = shell($cmd);
+        $lastPage = { dir => $currentDir, start => $currentListStartIndex, entries => [@trackList] };
+    }
                     
-    open(WRITER, ">response");
+    open(WRITER, ">response.tmp");
     foreach(@trackList)
     {
         $index = rindex($_, '/');
@@ -26,41 +144,934 @@ sub sendTracks($$)
         print WRITER $trackDirName;
     }
     close(WRITER);
+    publishResponse();
+}
+
+# Commands that are issued often go over a connection to MPD that stays open,
+# instead of forking mpc or nc for each of them. MPD closes connections that
+# have been idle for a while, so a failed command reconnects and tries once
+# more. Returns the response lines without the final OK, or nothing on an error.
+$mpd = undef;
+
+sub mpdCommand($)
+{
+    my ($command) = @_;
+    
+    for my $attempt (1 .. 2)
+    {
+        if(!$mpd)
+        {
+            $mpd = IO::Socket::INET->new(PeerAddr => $mpdHost, PeerPort => $mpdPort, Proto => "tcp") or return ();
+            my $greeting = <$mpd>;
+        }
+        
+        if(print $mpd "$command\n")
+        {
+            my @lines = ();
+            while(defined(my $line = <$mpd>))
+            {
+                return @lines if $line eq "OK\n";
+                return () if $line =~ /^ACK /;
+                push(@lines, $line);
+            }
+        }
+        
+        close($mpd);
+        $mpd = undef;
+    }
+    
+    return ();
+}
+
+# Quote an argument for the MPD protocol
+sub mpdQuote($)
+{
+    my ($arg) = @_;
+    
+    $arg =~ s/([\\"])/\\$1/g;
+    return "\"$arg\"";
+}
+
+# Adding a large directory to the queue takes MPD a while, as it reads the tags
+# of every file, and from a network share that adds up. So only the first file
+# is added before playback starts, and a child process adds the rest in
+# command lists of $enqueueBatch files, over a connection of its own. The queue
+# length on the display grows as it goes. The files come from listall, which
+# only reads MPD's database and gives them in the order "add" would queue
+# them. The child is reaped as soon as it is done, from the SIGCHLD handler.
+$enqueueBatch = 50;
+$enqueuePid = 0;
+
+# Stop adding files in the background, e.g. because the queue is replaced
+sub stopEnqueue()
+{
+    if($enqueuePid)
+    {
+        kill("TERM", $enqueuePid);
+        waitpid($enqueuePid, 0);
+        $enqueuePid = 0;
+    }
+}
+
+# Collect the child once it added all files. Only that child: the others
+# (backticks, system) are waited for where they are started.
+sub reapEnqueue()
+{
+    $enqueuePid = 0 if $enqueuePid and waitpid($enqueuePid, WNOHANG) != 0;
+}
+$SIG{CHLD} = \&reapEnqueue;
+
+sub playProgressively($)
+{
+    my ($uri) = @_;
+    
+    stopEnqueue();
+    mpdCommand("clear");
+    
+    my @files = map { /^file: (.*)$/ ? $1 : () } mpdCommand("listall ".mpdQuote($uri));
+    if(@files <= 1)
+    {
+        # A single file, or something listall does not know (e.g. a stream)
+        mpdCommand("add ".mpdQuote($uri));
+        mpdCommand("play 0");
+        return;
+    }
+    
+    mpdCommand("add ".mpdQuote(shift(@files)));
+    mpdCommand("play 0");
+    
+    countChild();
+    $enqueuePid = fork();
+    if(defined $enqueuePid and $enqueuePid == 0)
+    {
+        $mpd = undef;    # the connection stays with the parent
+        while(@files)
+        {
+            my @batch = splice(@files, 0, $enqueueBatch);
+            mpdCommand(join("\n", "command_list_begin", (map { "add ".mpdQuote($_) } @batch), "command_list_end"));
+        }
+        POSIX::_exit(0);    # no END blocks or destructors of the parent's copies
+    }
+    $enqueuePid = 0 unless defined $enqueuePid;
+}
+
+# Replace the queue by the radio streams
+sub loadStreams()
+{
+    stopEnqueue();
+    shell("$mpc clear");
+    shell("$mpc repeat on");
+    
+    shell("$mpc add http://205.188.215.232:8016                         ");    # di.fm Soulful House
+    shell("$mpc add http://scfire-ntc-aa03.stream.aol.com:80/stream/1009");    # di.fm Lounge
+    shell("$mpc add http://205.188.215.225:8002                         ");    # di.fm Breaks
+    shell("$mpc add http://scfire-ntc-aa03.stream.aol.com:80/stream/1025");    # di.fm Electro House
+    
+    shell("$mpc playlist");    # show the resulting playlist
+    
+    shell("$mpc play");
+}
+
+# Send a page of 4 entries of the queue, starting at position $start, as
+# "<position> <title>" lines
+sub sendQueue($)
+{
+    my ($start) = @_;
+    my @entries = ();
+    
+    foreach(mpdCommand("playlistinfo $start:".($start + 4)))
+    {
+        push(@entries, {}) if /^file: /;
+        $entries[-1]{$1} = $2 if @entries and /^(\w+): (.*)$/;
+    }
+    
+    open(WRITER, ">response.tmp");
+    foreach(@entries)
+    {
+        $title = $_->{Title} || $_->{Name} || "";
+        ($title = $_->{file}) =~ s/^.*\/// if $title eq "";
+        $title =~ s/,/ /g;    # commas separate the entries in the response
+        print WRITER ($_->{Pos} + 1)." ".$title."\n";
+    }
+    close(WRITER);
+    publishResponse();
+}
+
+# The AVR runs its own playback clock, so a status line only needs to be sent
+# when something other than the elapsed time changed, when the elapsed time
+# jumped (e.g. after a seek), or every $keyframeInterval seconds to correct
+# any drift.
+$keyframeInterval = 30;
+$lastStatus = "";
+$lastStatusTime = 0;
+$lastElapsed = 0;
+
+sub statusChanged($)
+{
+    ($status) = @_;
+    
+    $now = time();
+    ($elapsed) = $status =~ /time: (\d+)/;
+    $elapsed = 0 unless defined $elapsed;
+    ($statusWithoutTime = $status) =~ s/time: \S+ //;
+    
+    $expectedElapsed = $lastElapsed;
+    $expectedElapsed += $now - $lastStatusTime if $status =~ /state: play/;
+    
+    if($statusWithoutTime ne $lastStatus or abs($elapsed - $expectedElapsed) > 2 or $now - $lastStatusTime >= $keyframeInterval)
+    {
+        $lastStatus = $statusWithoutTime;
+        $lastStatusTime = $now;
+        $lastElapsed = $elapsed;
+        return 1;
+    }
+    
+    return 0;
+}
+
+# The firmware subscribes to the topics the current screen shows with
+# "sub <mask>" (see TOPIC_TRACK in parse.h), and only the fields of those
+# topics are pushed. With nothing subscribed (while browsing) MPD is not even
+# polled, so the replies to browse requests have the serial line to
+# themselves. A new subscription is pushed in full right away. The receiver
+# leaves the mask in a subscribe file; hello subscribes to everything again.
+# Both go through that one file, in the order the AVR sent them, so a "sub"
+# right after a hello cannot be undone by the sender seeing the hello later.
+$TOPIC_TRACK = 1;
+$TOPIC_VOLUME = 2;
+$TOPIC_QUEUE = 4;
+$TOPIC_EXTRAS = 8;
+$TOPIC_SPECTRUM = 16;
+$allTopics = $TOPIC_TRACK | $TOPIC_VOLUME | $TOPIC_QUEUE | $TOPIC_EXTRAS;
+%fieldTopic = (Name => $TOPIC_TRACK, Artist => $TOPIC_TRACK, Title => $TOPIC_TRACK, time => $TOPIC_TRACK, song => $TOPIC_TRACK,
+               state => $TOPIC_TRACK, volume => $TOPIC_VOLUME, playlistlength => $TOPIC_QUEUE);
+$topics = $allTopics;
+
+# The spectrum comes from spectrum.pl, which reads the fifo output of MPD and
+# writes to the serial port itself. It is started when SPECTRUM_FIFO names
+# that fifo, and only sends while the firmware is subscribed to the spectrum.
+$spectrumFifo = $ENV{SPECTRUM_FIFO} || "";
+$spectrumPid = 0;
+$spectrumOn = 0;
+
+sub startSpectrum()
+{
+    countChild();
+    $spectrumPid = fork();
+    if(defined $spectrumPid and $spectrumPid == 0)
+    {
+        exec($^X, "spectrum.pl", "--fifo", $spectrumFifo, "--tty", $tty);
+        exit(1);
+    }
+    $spectrumPid = 0 unless defined $spectrumPid;
+}
+
+# Switch the spectrum output on or off to match the subscription
+sub updateSpectrum()
+{
+    my $on = $topics & $TOPIC_SPECTRUM ? 1 : 0;
+    
+    if($spectrumPid and $on != $spectrumOn)
+    {
+        kill($on ? "USR1" : "USR2", $spectrumPid);
+        $spectrumOn = $on;
+    }
+}
+
+# Information for the extra pages of the playing screen: the next song, the
+# audio format and the length of the queue. These are sent in a line of their
+# own, and only when they change; the bitrate of VBR files and streams changes
+# all the time, so it does not count as a change and is only updated along
+# with the rest or with a keyframe.
+$lastPlaylistKey = "";
+$lastPlaylistVersion = "";
+$nextInfo = "";
+$queueMinutes = 0;
+$lastExtras = "";
+$lastExtrasTime = 0;
+
+sub mpdFields(@)
+{
+    my %fields = ();
+    
+    foreach(@_)
+    {
+        $fields{$1} = $2 if /^(\w+): (.*)$/ and !exists $fields{$1};
+    }
+    return %fields;
+}
+
+sub trackExtras(@)
+{
+    my %status = mpdFields(@_);
+    my $nextSong = defined $status{nextsong} ? $status{nextsong} : "";
+    my $playlistVersion = defined $status{playlist} ? $status{playlist} : "";
+    
+    # MPD is only asked about the next song when the playlist or the position
+    # in it changed, and about the length of the queue when the playlist did
+    if("$playlistVersion $nextSong" ne $lastPlaylistKey)
+    {
+        $lastPlaylistKey = "$playlistVersion $nextSong";
+        $nextArtist = $nextTitle = "";
+        if($nextSong ne "")
+        {
+            my %next = mpdFields(shell("echo \"playlistinfo $nextSong\" | nc $mpdHost $mpdPort"));
+            $nextArtist = $next{Artist} || $next{Name} || "";
+            $nextTitle = $next{Title} || "";
+            ($nextTitle = $next{file} || "") =~ s/^.*\/// if $nextTitle eq "";
+        }
+        $nextInfo = "nextartist: ".substr(toLcd($nextArtist), 0, 20)." nexttitle: ".substr(toLcd($nextTitle), 0, 20)." ";
+    }
+    
+    if($playlistVersion ne $lastPlaylistVersion)
+    {
+        $lastPlaylistVersion = $playlistVersion;
+        $queueSeconds = 0;
+        foreach(shell("echo \"playlistinfo\" | nc $mpdHost $mpdPort"))
+        {
+            $queueSeconds += $1 if /^Time: (\d+)/;
+        }
+        $queueMinutes = int(($queueSeconds + 59) / 60);
+    }
+    
+    # "44100:16:2" becomes "44.1kHz 16bit stereo"
+    $audio = "";
+    if(defined $status{audio} and $status{audio} =~ /^(\d+):(\w+):(\d+)/)
+    {
+        my ($rate, $bits, $channels) = ($1, $2, $3);
+        $bits .= "bit" if $bits =~ /^\d+$/;    # or "f" for floating point
+        $audio = ($rate / 1000)."kHz $bits ".($channels == 1 ? "mono" : $channels == 2 ? "stereo" : $channels."ch");
+    }
+    $bitrate = $status{bitrate} || 0;
+    
+    return $nextInfo."audio: $audio bitrate: $bitrate queuemins: $queueMinutes ";
+}
+
+sub extrasChanged($)
+{
+    ($extras) = @_;
+    
+    $now = time();
+    ($extrasWithoutBitrate = $extras) =~ s/bitrate: \d+ //;
+    
+    if($extrasWithoutBitrate ne $lastExtras or $now - $lastExtrasTime >= $keyframeInterval)
+    {
+        $lastExtras = $extrasWithoutBitrate;
+        $lastExtrasTime = $now;
+        return 1;
+    }
+    
+    return 0;
+}
+
+# The AVR keeps the strings it was sent in a small cache (see STR_REF in
+# parse.h). @strSlots mirrors what each slot holds, so a string the AVR
+# already has is sent as a three byte reference to its slot, and a new one
+# replaces the least recently used string. A reference ends with a check
+# character, the sum of the first $strLen characters (what the AVR keeps)
+# modulo 64, so the AVR notices a slot that missed its store because a line
+# was lost. The mirror is cleared when the AVR says hello (after a reset, or
+# when it got a reference it could not resolve) and every $keyframeInterval
+# seconds, after which all strings go out in full again.
+$numStrSlots = 8;
+$strLen = 20;
+$stringKeys = "Artist|Title|Name|nextartist|nexttitle";
+$allKeys = "$stringKeys|volume|playlistlength|state|song|time|audio|bitrate|queuemins";
+
+sub clearStringCache()
+{
+    @strSlots = ();
+    @strSlotUse = (0) x $numStrSlots;
+    $strUseClock = 0;
+    $lastCacheClear = time();
+}
+
+sub cacheString($)
+{
+    my ($text) = @_;
+    
+    $text =~ s/ +$//;    # the AVR drops trailing spaces as well
+    return $text if length($text) <= 2;    # not worth a slot
+    
+    $strUseClock++;
+    for my $slot (0..$numStrSlots - 1)
+    {
+        if(defined $strSlots[$slot] and $strSlots[$slot] eq $text)
+        {
+            $strSlotUse[$slot] = $strUseClock;
+            return "\x01".chr(ord("0") + $slot).chr(ord("0") + unpack("%6C*", substr($text, 0, $strLen)));
+        }
+    }
+    
+    my $slot = 0;
+    for (1..$numStrSlots - 1)
+    {
+        $slot = $_ if $strSlotUse[$_] < $strSlotUse[$slot];
+    }
+    $strSlots[$slot] = $text;
+    $strSlotUse[$slot] = $strUseClock;
+    return "\x02".chr(ord("0") + $slot).$text;
+}
+
+# Replace the string fields of a status or extras line by cache references
+sub encodeStrings($)
+{
+    my ($line) = @_;
+    
+    $line =~ s/\b($stringKeys): (.*?) (?=(?:$allKeys): |$)/"$1: ".cacheString($2)." "/ge;
+    return $line;
+}
+
+# Directory listings are sorted, so an entry often starts like the one before
+# it. Such an entry is sent as the length of the shared start and the rest.
+sub frontCode($$)
+{
+    my ($previous, $entry) = @_;
+    my $prefix = 0;
+    
+    $prefix++ while $prefix < length($previous) and $prefix < length($entry) and substr($previous, $prefix, 1) eq substr($entry, $prefix, 1);
+    return $prefix > 2 ? "\x03".chr(ord("0") + $prefix).substr($entry, $prefix) : $entry;
+}
+
+# Instrumentation. Both processes count, per command (the verb of a command
+# from the AVR, "status" for a poll of MPD by the sender, "response" for a
+# response it passes on): how often it came in, how long it took from reading
+# it to having handled it (written the response, for requests), the CPU time
+# it took, the bytes read and written on the serial line and the child
+# processes started. For "response" the time runs from the moment the
+# receiver read the request, so it is the whole wait for a browse page. Each
+# process writes its numbers every $metricsInterval seconds to
+# $METRICS_DIR/wifiradio_<process>.prom, in the Prometheus text format (e.g.
+# for the node exporter's textfile collector), and prints them on SIGUSR1.
+$metricsDir = $ENV{METRICS_DIR} || ".";
+$metricsInterval = 10;
+@latencyBuckets = (0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10);
+%metrics = ();
+$metricsCommand = "other";
+$lastMetricsWrite = 0;
+
+# Start handling a command that came with $bytes bytes
+sub metricsStart($$)
+{
+    my ($command, $bytes) = @_;
+    
+    $metricsCommand = $command;
+    $metricsStartTime = Time::HiRes::time();
+    @metricsStartCpu = times();
+    $metrics{$command}{bytesIn} += $bytes;
+}
+
+# Done handling the command. Also writes the file when it is time to.
+sub metricsEnd()
+{
+    my $seconds = Time::HiRes::time() - $metricsStartTime;
+    my @cpu = times();
+    my $m = $metrics{$metricsCommand};
+    
+    $m->{count}++;
+    $m->{sum} += $seconds;
+    # User and system time of the process and of the children it waited for,
+    # in clock ticks (usually 10 ms), so only the sum over many commands
+    # means something
+    $m->{cpu} += $cpu[$_] - $metricsStartCpu[$_] for (0 .. 3);
+    for my $i (0..$#latencyBuckets)
+    {
+        $m->{buckets}[$i]++ if $seconds <= $latencyBuckets[$i];
+    }
+    $metricsCommand = "other";
+    
+    if(time() - $lastMetricsWrite >= $metricsInterval)
+    {
+        $lastMetricsWrite = time();
+        if(open(METRICS, ">", "$metricsDir/wifiradio_$metricsProcess.prom.tmp"))
+        {
+            print METRICS metricsText();
+            close(METRICS);
+            rename("$metricsDir/wifiradio_$metricsProcess.prom.tmp", "$metricsDir/wifiradio_$metricsProcess.prom");
+        }
+    }
+}
+
+# The receiver has written a response to a request. It only appears under
+# its real name once complete, dated when the request came in (see "response"
+# above).
+sub publishResponse()
+{
+    Time::HiRes::utime($metricsStartTime, $metricsStartTime, "response.tmp");
+    rename("response.tmp", "response");
+}
+
+# The receiver passes a topic mask on to the sender. Like a response, it only
+# appears complete, and the last one written wins.
+sub publishTopics($)
+{
+    my ($mask) = @_;
+    
+    open(WRITER, ">subscribe.tmp");
+    print WRITER $mask;
+    close(WRITER);
+    rename("subscribe.tmp", "subscribe");
+}
+
+sub countChild()
+{
+    $metrics{$metricsCommand}{children}++;
+}
+
+# Run a shell command and return its output, like backticks
+sub shell($)
+{
+    my ($command) = @_;
+    
+    countChild();
+    return `$command`;
+}
+
+sub metricsText()
+{
+    my $text = "";
+    my $labels;
+    
+    $text .= "# TYPE wifiradio_command_seconds histogram\n";
+    foreach my $command (sort keys %metrics)
+    {
+        my $m = $metrics{$command};
+        $labels = "process=\"$metricsProcess\",command=\"$command\"";
+        for my $i (0..$#latencyBuckets)
+        {
+            $text .= "wifiradio_command_seconds_bucket{$labels,le=\"$latencyBuckets[$i]\"} ".($m->{buckets}[$i] || 0)."\n";
+        }
+        $text .= "wifiradio_command_seconds_bucket{$labels,le=\"+Inf\"} ".($m->{count} || 0)."\n";
+        $text .= "wifiradio_command_seconds_sum{$labels} ".sprintf("%.6f", $m->{sum} || 0)."\n";
+        $text .= "wifiradio_command_seconds_count{$labels} ".($m->{count} || 0)."\n";
+    }
+    $text .= "# TYPE wifiradio_command_cpu_seconds_total counter\n";
+    foreach my $command (sort keys %metrics)
+    {
+        $text .= "wifiradio_command_cpu_seconds_total{process=\"$metricsProcess\",command=\"$command\"} ".sprintf("%.2f", $metrics{$command}{cpu} || 0)."\n";
+    }
+    foreach my $counter (["bytesIn", "wifiradio_serial_bytes_in_total"], ["bytesOut", "wifiradio_serial_bytes_out_total"],
+                         ["children", "wifiradio_child_processes_total"])
+    {
+        $text .= "# TYPE $counter->[1] counter\n";
+        foreach my $command (sort keys %metrics)
+        {
+            $text .= "$counter->[1]\{process=\"$metricsProcess\",command=\"$command\"} ".($metrics{$command}{$counter->[0]} || 0)."\n";
+        }
+    }
+    
+    return $text;
+}
+
+# Sleep between two polls of MPD, but wake up as soon as the receiver leaves
+# a file for the sender, so a browse page does not wait for the next poll
+sub senderSleep($)
+{
+    my ($seconds) = @_;
+    my $until = Time::HiRes::time() + $seconds;
+    
+    while(Time::HiRes::time() < $until and !-e "response" and !-e "hello" and !-e "subscribe")
+    {
+        Time::HiRes::sleep(0.02);
+    }
+}
+
+sub sendLine($)
+{
+    ($line) = @_;
+    
+    print "Sending: ".$line."\n";
+    ($quotedString = $line) =~ s/\'/\'\\\'\'/g;	# quote for the shell
+    countChild();
+    system('printf \'%s\\n\' \''.$quotedString.'\' > '.$tty."\n");    # unlike echo, leaves backslashes alone
+    $metrics{$metricsCommand}{bytesOut} += length($line) + 1;
+}
+
+# Thin-client mode (THIN_CLIENT=1, for firmware built with THIN_CLIENT = 1):
+# the script draws the screens itself and the AVR only shows them. The sender
+# keeps the frame the screen should show, and sends the cells that differ from
+# what the AVR acknowledged as "scr: <id><pos><len><bytes>..." patches (see
+# thin.c), one run per stretch of changed cells. Cells of a patch that has not
+# been acknowledged yet count as unknown, so they are sent again with the next
+# patch; an unchanged patch is repeated once per $thinResendInterval seconds
+# until its ack comes. The receiver passes key presses, acks and hello on to
+# the sender through a pipe.
+$thinClient = $ENV{THIN_CLIENT} || 0;
+$thinWidth = 20;
+$thinLines = 4;
+$thinResendInterval = 1;
+$thinVolumeSeconds = 2;
+pipe(UI_READ, UI_WRITE) if $thinClient;
+
+# Keys, as numbered in buttons.h
+($KEY_UP, $KEY_DOWN, $KEY_LEFT, $KEY_RIGHT, $KEY_ENTER, $KEY_SWITCH) = (0 .. 5);
+
+sub thinReset()
+{
+    @thinShown = ();    # per cell, what the AVR shows; undef if unknown
+    @thinOwner = ();    # per cell, the id of the last patch that changed it
+    %thinSent = ();     # per patch id, the cells it changed
+    $thinLastPatch = "";
+}
+
+# Pad or cut text from MPD to one line of the display
+sub thinLine($)
+{
+    my ($text) = @_;
+    
+    return substr(toLcd($text).(" " x $thinWidth), 0, $thinWidth);
+}
+
+sub thinBar($$)
+{
+    my ($value, $maxValue) = @_;
+    my $cells = $maxValue > 0 ? int($value * $thinWidth / $maxValue) : 0;
+    
+    $cells = $thinWidth if $cells > $thinWidth;
+    return ("\xFF" x $cells).("-" x ($thinWidth - $cells));
+}
+
+# List a directory for browsing
+sub thinList($)
+{
+    my ($dir) = @_;
+    
+    $thinDir = $dir;
+    $thinIndex = 0;
+    @thinEntries = ();
+    foreach(mpdCommand("lsinfo ".mpdQuote($dir)))
+    {
+        push(@thinEntries, { uri => $2, dir => $1 eq "directory" }) if /^(directory|file): (.*)$/;
+    }
+}
+
+sub thinDraw()
+{
+    my @lines;
+    
+    if($thinMode eq "browsing")
+    {
+        my $start = $thinIndex - $thinIndex % $thinLines;
+        
+        for my $i ($start .. $start + $thinLines - 1)
+        {
+            my $entry = $thinEntries[$i];
+            my $name = "";
+            
+            ($name = $entry->{uri}) =~ s/^.*\/// if defined $entry;
+            push(@lines, ($i == $thinIndex ? ">" : " ").substr(thinLine($name), 0, $thinWidth - 1));
+        }
+        $lines[0] = thinLine(" (empty)") unless @thinEntries;
+    }
+    else
+    {
+        my %s = %thinStatus;
+        my ($elapsed, $length) = defined $s{time} && $s{time} =~ /^(\d+):(\d+)/ ? ($1, $2) : (0, 0);
+        my $state = !defined $s{state} ? "#" : $s{state} eq "play" ? ">" : $s{state} eq "pause" ? "|" : "#";
+        my $clock = sprintf("%s %d:%02d", $state, $elapsed / 60, $elapsed % 60);
+        my $position = defined $s{song} ? ($s{song} + 1)."/".($s{playlistlength} || 0) : "";
+        my $title = $s{Title};
+        
+        ($title = $s{file} || "") =~ s/^.*\/// unless defined $title;
+        push(@lines, $clock.(" " x ($thinWidth - length($clock) - length($position))).$position);
+        push(@lines, thinLine($s{Artist} || $s{Name} || ""));
+        push(@lines, thinLine($title));
+        if(time() < $thinVolumeUntil)
+        {
+            my $volume = sprintf("Vol %3d%% ", $s{volume} || 0);
+            push(@lines, $volume.substr(thinBar($s{volume} || 0, 100), 0, $thinWidth - length($volume)));
+        }
+        else
+        {
+            push(@lines, thinBar($elapsed, $length));
+        }
+    }
+    
+    $thinFrame = join("", map { substr($_.(" " x $thinWidth), 0, $thinWidth) } @lines);
+}
+
+# Send the cells that differ from what the AVR shows. Runs of changed cells
+# less than 3 apart are merged, as a new run costs 2 bytes of its own.
+sub thinSend()
+{
+    my $patch = "";
+    my %cells = ();
+    
+    for my $line (0 .. $thinLines - 1)
+    {
+        my $runStart = -1;
+        my $runEnd = -1;
+        
+        for my $x (0 .. $thinWidth)
+        {
+            my $pos = $line * $thinWidth + $x;
+            my $differs = $x < $thinWidth && (!defined $thinShown[$pos] || $thinShown[$pos] ne substr($thinFrame, $pos, 1));
+            
+            if($differs and $runStart >= 0 and $pos - $runEnd <= 3)
+            {
+                $runEnd = $pos;
+            }
+            elsif($differs or $x == $thinWidth)
+            {
+                if($runStart >= 0)
+                {
+                    $patch .= chr(ord("0") + $runStart).chr(ord("0") + $runEnd - $runStart + 1).substr($thinFrame, $runStart, $runEnd - $runStart + 1);
+                    $cells{$_} = substr($thinFrame, $_, 1) for ($runStart .. $runEnd);
+                }
+                ($runStart, $runEnd) = $differs ? ($pos, $pos) : (-1, -1);
+            }
+        }
+    }
+    
+    return if $patch eq "";
+    return if $patch eq $thinLastPatch and Time::HiRes::time() - $thinLastSendTime < $thinResendInterval;
+    
+    $thinSeq = (($thinSeq || 0) + 1) % 10;
+    $thinSent{$thinSeq} = \%cells;
+    foreach(keys %cells)
+    {
+        $thinShown[$_] = undef;
+        $thinOwner[$_] = $thinSeq;
+    }
+    $thinLastPatch = $patch;
+    $thinLastSendTime = Time::HiRes::time();
+    sendLine("scr: $thinSeq$patch");
+}
+
+# The AVR shows patch $id
+sub thinAck($)
+{
+    my ($id) = @_;
+    my $cells = delete $thinSent{$id} or return;
+    
+    foreach(keys %$cells)
+    {
+        # A later patch that is still on its way may have changed the cell again
+        if(defined $thinOwner[$_] and $thinOwner[$_] == $id)
+        {
+            $thinShown[$_] = $cells->{$_};
+            $thinOwner[$_] = undef;
+        }
+    }
+    $thinLastPatch = "";
+}
+
+sub thinKey($)
+{
+    my ($key) = @_;
+    
+    if($thinMode eq "browsing")
+    {
+        my $entry = $thinEntries[$thinIndex];
+        
+        if($key == $KEY_UP and $thinIndex > 0)
+        {
+            $thinIndex--;
+        }
+        elsif($key == $KEY_DOWN and $thinIndex < $#thinEntries)
+        {
+            $thinIndex++;
+        }
+        elsif($key == $KEY_RIGHT and defined $entry and $entry->{dir})
+        {
+            push(@thinDirs, [$thinDir, $thinIndex, [@thinEntries]]);
+            thinList($entry->{uri});
+        }
+        elsif($key == $KEY_LEFT and @thinDirs)
+        {
+            # The parent's listing is kept, so there is no need to ask MPD
+            my $entries;
+            ($thinDir, $thinIndex, $entries) = @{pop(@thinDirs)};
+            @thinEntries = @$entries;
+        }
+        elsif($key == $KEY_ENTER and defined $entry)
+        {
+            playProgressively($entry->{uri});
+            $thinMode = "playing";
+        }
+        elsif($key == $KEY_SWITCH)
+        {
+            loadStreams();
+            $thinMode = "playing";
+        }
+    }
+    else
+    {
+        # No volume to step from while MPD reports none (no mixer)
+        if(($key == $KEY_UP or $key == $KEY_DOWN) and ($thinStatus{volume} // -1) >= 0)
+        {
+            my $volume = ($thinStatus{volume} || 0) + ($key == $KEY_UP ? 5 : -5);
+            
+            $volume = 0 if $volume < 0;
+            $volume = 100 if $volume > 100;
+            mpdCommand("setvol $volume");
+            $thinStatus{volume} = $volume;
+            $thinVolumeUntil = time() + $thinVolumeSeconds;
+        }
+        elsif($key == $KEY_LEFT)
+        {
+            mpdCommand("previous");
+        }
+        elsif($key == $KEY_RIGHT)
+        {
+            mpdCommand("next");
+        }
+        elsif($key == $KEY_SWITCH)
+        {
+            @thinDirs = ();
+            thinList("");
+            $thinMode = "browsing";
+        }
+    }
+}
+
+sub thinPoll()
+{
+    %thinStatus = (mpdFields(mpdCommand("status")), mpdFields(mpdCommand("currentsong")));
+}
+
+# The sender in thin-client mode: redraw after every key press, and after
+# polling MPD once per second
+sub thinClientLoop()
+{
+    my $events = "";
+    my $lastPoll = 0;
+    
+    close(UI_WRITE);
+    thinReset();
+    $thinMode = "playing";
+    $thinVolumeUntil = 0;
+    
+    while(1)
+    {
+        my $ready = "";
+        vec($ready, fileno(UI_READ), 1) = 1;
+        if(select($ready, undef, undef, 0.2) > 0)
+        {
+            sysread(UI_READ, $events, 256, length($events)) or exit(0);    # the receiver is gone
+        }
+        
+        while($events =~ s/^(.*)\n//)
+        {
+            my $event = $1;
+            
+            if($event =~ /^scr (\d)$/)
+            {
+                thinAck($1);
+            }
+            elsif($event eq "hello")
+            {
+                thinReset();
+            }
+            elsif($event =~ /^key (\d)$/)
+            {
+                metricsStart("key", 0);
+                thinKey($1);
+                thinPoll();    # show the effect right away
+                $lastPoll = Time::HiRes::time();
+                thinDraw();
+                thinSend();
+                metricsEnd();
+            }
+        }
+        
+        if(Time::HiRes::time() - $lastPoll >= 1)
+        {
+            metricsStart("status", 0);
+            $lastPoll = Time::HiRes::time();
+            thinPoll();
+            thinDraw();
+            thinSend();
+            metricsEnd();
+        }
+        else
+        {
+            thinSend();    # repeats a patch whose ack is overdue
+        }
+    }
 }
-                                                                                                                                
 
 if (fork) 
 {
+	# "kill -USR1 <pid of this process>" prints the metrics, and asks the
+	# firmware for its task statistics, which the receiver prints
+	$metricsProcess = "sender";
+	$SIG{PIPE} = "IGNORE";    # as in the receiver: mpdCommand() is used here too, all through thin mode
+	$statsRequested = 0;
+	$SIG{USR1} = sub { print metricsText(); $statsRequested = 1; };
+	clearStringCache();
+	thinClientLoop() if $thinClient;
+	startSpectrum() if $spectrumFifo;
+
     	while(1)
 	{
 		$totalString = "";
+		$extraString = "";
 	
+		if($statsRequested)
+		{
+			$statsRequested = 0;
+			sendLine("stats?");
+		}
+
+		# The receiver leaves a hello file when the AVR says hello
+		if(-e "hello")
+		{
+			unlink("hello");
+			$lastStatus = "";
+			$lastExtras = "";
+			clearStringCache();
+		}
+		elsif(time() - $lastCacheClear >= $keyframeInterval)
+		{
+			clearStringCache();
+		}
+
+		# Moved aside before reading, so a mask the receiver writes meanwhile
+		# waits for the next pass instead of being deleted unread
+		if(rename("subscribe", "subscribe.read"))
+		{
+			open READER, "<", "subscribe.read";
+			$topics = <READER> + 0;
+			close(READER);
+			unlink("subscribe.read");
+			$lastStatus = "";
+			$lastExtras = "";
+		}
+		updateSpectrum();
+
 		if(-e "response")
 		{
+			metricsStart("response", 0);
+			$metricsStartTime = (Time::HiRes::stat("response"))[9];
 			open READER, "<", "response"; 
 
+			$previous = "";
 			while (<READER>) 
 			{ 
 				$line = $_;
 				chomp($line);
-				$totalString .= substr($line, 0, 19);
+				$entry = substr(toLcd($line), 0, 19);
+				$totalString .= frontCode($previous, $entry);
 				$totalString .= ","; 
+				($previous = $entry) =~ s/ +$//;
 			}
 			close(READER);
 			unlink("response");
 			$totalString = "resp: ".$totalString;	
 		}
-		else
+		elsif($topics)
 		{
-			@songInfo = `echo "currentsong" | nc localhost 6600`;
-			@statusInfo = `echo "status" | nc localhost 6600`;	
+			metricsStart("status", 0);
+			@songInfo = shell("echo \"currentsong\" | nc $mpdHost $mpdPort");
+			@statusInfo = shell("echo \"status\" | nc $mpdHost $mpdPort");	
 			
 			chomp(@songInfo);
 			foreach(@songInfo)
 			{
-				if($_ =~ /^Name: / or $_ =~ /^Artist: / or $_ =~ /^Title: /)
+				if($_ =~ /^(Name|Artist|Title): / and $topics & $fieldTopic{$1})
 				{
-					$totalString .= substr($_,0,28);
+					$totalString .= substr(toLcd($_),0,28);
 					$totalString .= " "; 
 				}
 			}
@@ -68,48 +1079,94 @@ if (fork)
 			chomp(@statusInfo);
 			foreach(@statusInfo)
 			{
-		                if($_ =~ /^time: / or $_ =~ /^playlistlength: / or $_ =~ /^song: /)
+		                if($_ =~ /^(time|playlistlength|song|state|volume): / and $topics & $fieldTopic{$1})
 		                {
 		                	$totalString .= $_;
 					$totalString .= " "; 
 		                }
 			}
+			
+			$extraString = trackExtras(@statusInfo) if $topics & $TOPIC_EXTRAS;
+		}
+		else
+		{
+			senderSleep(1);
+			next;
 		}
 			
-		$totalString =~ s/\'//;	
 		
-		print "Sending: ".$totalString."\n";
-			
-		$commandString = 'echo \''.$totalString.'\' > /dev/tts/1'."\n";
-			
-		system($commandString);
+		if($totalString =~ /^resp: /)
+		{
+			sendLine($totalString);
+		}
+		elsif($totalString ne "" and statusChanged($totalString))
+		{
+			sendLine(encodeStrings($totalString));
+		}
+		
+		if($extraString ne "" and extrasChanged($extraString))
+		{
+			sendLine(encodeStrings($extraString));
+		}
+		metricsEnd();
 		
-		sleep(1);
+		senderSleep(1);
 	}
 }
 else
 {
+	$SIG{PIPE} = "IGNORE";    # a dropped MPD connection shows up as a failed print instead
+	$metricsProcess = "receiver";
+	$SIG{USR1} = sub { print metricsText(); };
 	@currentDir = ();
+	$lastSeq = "";
+	if($thinClient)
+	{
+		close(UI_READ);
+		select((select(UI_WRITE), $| = 1)[0]);
+	}
 	while(1)
 	{
-		$command = `head -n 1 < /dev/tts/1`;
-		$command =~ s/^cmd://;
+		$command = `head -n 1 < $tty`;
+		($verb) = $command =~ /^cmd\d?:([a-z]+)/;
+		metricsStart(defined $verb ? $verb : "other", length($command));
+		countChild();    # the head that read it
 		chomp($command);
 		
 		print "Received: ".$command."\n";
 		
+		# Commands come numbered ("cmd3:next", see link.h), and every one is
+		# acknowledged right away. The AVR sends a command again when the ack
+		# does not come in time, so a number that was just seen means the ack
+		# got lost and the command was already carried out. Hello starts the
+		# numbering over.
+		if($command =~ s/^cmd(\d)://)
+		{
+			$seq = $1;
+			sendLine("ack: $seq");
+			if($seq eq $lastSeq and $command ne "hello")
+			{
+				print "Duplicate, ignored\n";
+				next;
+			}
+			$lastSeq = $seq;
+		}
+		$command =~ s/^cmd://;
+		
+		# In thin-client mode, the sender takes care of the screen
+		if($thinClient and $command =~ /^(key \d|scr \d|hello)$/)
+		{
+			print UI_WRITE $command."\n";
+			next;
+		}
+		
 		if($command eq "getfirsttracks")
 		{
-		    `./mpc stop`;
+		    shell("$mpc stop");
 		    @currentDir = ();
-		    @trackList = `./mpc ls | head -n 4`;
-		                                                                                                                 
-		    open(WRITER, ">response");
-		    foreach(@trackList)
-		    {
-	                print WRITER $_;
-                    }
-	            close(WRITER);
+		    @breadcrumbs = ();
+		    $lastPage = undef;    # the library may have changed since
+		    sendTracks("", 0);
                 }
 		                                                                                                                                                                                                                                                                                         
 		if($command =~ m/^gettracks\s(\d+)\s(\d+)/)
@@ -126,14 +1183,14 @@ else
 	            $currentListSelectedIndex = $2;
 	            
                     $currentDir = join "/",@currentDir;
-                    @trackList = `./mpc ls $currentDir`;
+                    @trackList = shell("$mpc ls $currentDir");
                     
-                    $entryToPlay .= $trackList[$currentListStartIndex + $currentListSelectedIndex];
-                    $entryToPlay =~ s/ /\\ /g;
-                   
-                    `./mpc clear`;
-                    `./mpc add $entryToPlay`;
-                    `./mpc play`;
+                    $entryToPlay = $trackList[$currentListStartIndex + $currentListSelectedIndex];
+                    if(defined $entryToPlay)
+                    {
+                        chomp($entryToPlay);
+                        playProgressively($entryToPlay);
+                    }
 	        }
 		
 		if($command =~ m/^dirdown\s(\d+)\s(\d+)/)
@@ -142,7 +1199,7 @@ else
                     $currentListSelectedIndex = $2;
 
                     $currentDir = join "/",@currentDir;
-                    @trackList = `./mpc ls $currentDir`;
+                    @trackList = shell("$mpc ls $currentDir");
 
                     $newDir = $trackList[$currentListStartIndex + $currentListSelectedIndex];
                     chomp($newDir);
@@ -157,54 +1214,116 @@ else
                     }
 	            $trackDirName =~ s/ /\\ /g;
                     
+                    push(@breadcrumbs, { start => $currentListStartIndex, selected => $currentListSelectedIndex,
+                                         page => $lastPage && $lastPage->{dir} eq $currentDir && $lastPage->{start} == $currentListStartIndex ? $lastPage : undef });
                     push(@currentDir, $trackDirName);
 
                     $currentDir = join "/",@currentDir;
                     sendTracks($currentDir, 0);
 		}
 		
-		if($command eq "dirup")
+		# With the position of the parent ("dirup <start> <selected>"), the
+		# AVR shows the parent's page from its breadcrumb; without, it has
+		# none left and waits for the parent from the start
+		if($command =~ m/^dirup(\s(\d+)\s(\d+))?$/)
 		{
 		    pop(@currentDir);
+		    $crumb = pop(@breadcrumbs);
 		    
 		    $currentDir = join "/", @currentDir;
-		    sendTracks($currentDir, 0);
+		    if(defined $1)
+		    {
+		        $currentListStartIndex = $2;
+		        $currentListSelectedIndex = $3;
+		        $lastPage = $crumb->{page} if defined $crumb and defined $crumb->{page};
+		    }
+		    else
+		    {
+		        sendTracks($currentDir, 0);
+		    }
 		}
 	
 		if($command eq "next")	
 		{
-			`./mpc next`;
+			shell("$mpc next");
 		}
 		                   
 		if($command eq "prev")	
 		{
-		        `./mpc prev`;
+		        shell("$mpc prev");
+		}
+
+		# Pages of the queue view
+		if($command =~ m/^getqueue\s(\d+)\s(\d+)/)
+		{
+			sendQueue($1);
+		}
+		
+		if($command =~ m/^delqueue\s(\d+)\s(\d+)/)
+		{
+			mpdCommand("delete ".($1 + $2));
+			sendQueue($1);
+		}
+
+		# Jump to a song in the playlist (1 based, like mpc). The firmware
+		# sends this once after a burst of next/prev presses.
+		if($command =~ m/^jump\s(\d+)/)
+		{
+			shell("$mpc play $1");
 		}
 		                                         
 		if($command eq "volup")	
 		{
-			`./mpc volume +5`;
+			shell("$mpc volume +5");
 		}
 		                                                               
 		if($command eq "voldown")	
 		{
-			`./mpc volume -5`;
+			shell("$mpc volume -5");
                 }
+
+		if($command =~ m/^setvol\s(\d+)/)
+		{
+			shell("$mpc volume $1");
+		}
+
+		# Topics to push from now on
+		if($command =~ m/^sub\s(\d+)/)
+		{
+			publishTopics($1);
+		}
+
+		# The AVR (re)started, or lost track of its string cache
+		if($command eq "hello")
+		{
+			publishTopics($allTopics);
+			open(WRITER, ">hello");
+			close(WRITER);
+		}
+
+		# Reply to stats?: worst-case run time in us and missed deadlines
+		# for each firmware task, in the order main() adds them, then the
+		# bytes of SRAM the stack has never reached
+		if($command =~ m/^stats\s([\d\s]+)/)
+		{
+			@stats = split(" ", $1);
+			foreach $task ("serial", "ui", "display", "link")
+			{
+				last if @stats < 2;
+				($wcet, $misses) = splice(@stats, 0, 2);
+				print "Task ".$task.": worst case ".$wcet." us, ".$misses." missed deadlines\n";
+			}
+			print "Stack: ".$stats[0]." bytes never used\n" if @stats == 1;
+		}
 		
 		if($command eq "loadstreams")
 		{
-	                `./mpc clear`;
-                        `./mpc repeat on`;
-                           
-                        `./mpc add http://205.188.215.232:8016                         `;    # di.fm Soulful House
-                        `./mpc add http://scfire-ntc-aa03.stream.aol.com:80/stream/1009`;    # di.fm Lounge
-                        `./mpc add http://205.188.215.225:8002                         `;    # di.fm Breaks
-                        `./mpc add http://scfire-ntc-aa03.stream.aol.com:80/stream/1025`;    # di.fm Electro House
-                                                           
-                        `./mpc playlist`;    # show the resulting playlist
-                                                                  
-                	`./mpc play`;
-        	}
+			loadStreams();
+		}
                                                                 
 	}
+	continue
+	{
+		metricsEnd();
+	}
 }
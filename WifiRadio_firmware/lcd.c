@@ -42,6 +42,30 @@
 
 
 #if LCD_IO_MODE
+/*
+** data pins: the nibble <-> port bit mapping is derived at compile time from
+** the pin configuration in lcd.h, so any order of the data pins on one port
+** costs a single port write per nibble, also for the reversed pins of this
+** board (PC3..PC0).
+*/
+#define LCD_DATA_MASK   ( _BV(LCD_DATA0_PIN) | _BV(LCD_DATA1_PIN) | _BV(LCD_DATA2_PIN) | _BV(LCD_DATA3_PIN) )
+
+/* port bits that show nibble n */
+#define LCD_NIBBLE_TO_PORT(n) ( (((n) & 0x01) ? _BV(LCD_DATA0_PIN) : 0) | (((n) & 0x02) ? _BV(LCD_DATA1_PIN) : 0) \
+                              | (((n) & 0x04) ? _BV(LCD_DATA2_PIN) : 0) | (((n) & 0x08) ? _BV(LCD_DATA3_PIN) : 0) )
+
+/* lowest data pin */
+#define LCD_DATA_MIN2(a,b)  ( (a) < (b) ? (a) : (b) )
+#define LCD_DATA_SHIFT      LCD_DATA_MIN2( LCD_DATA_MIN2(LCD_DATA0_PIN, LCD_DATA1_PIN), LCD_DATA_MIN2(LCD_DATA2_PIN, LCD_DATA3_PIN) )
+
+/* nibble read from 4 adjacent port bits p, shifted down to bits 0..3 */
+#define LCD_PORT_TO_NIBBLE(p) ( ((((p) << LCD_DATA_SHIFT) & _BV(LCD_DATA0_PIN)) ? 0x01 : 0) | ((((p) << LCD_DATA_SHIFT) & _BV(LCD_DATA1_PIN)) ? 0x02 : 0) \
+                              | ((((p) << LCD_DATA_SHIFT) & _BV(LCD_DATA2_PIN)) ? 0x04 : 0) | ((((p) << LCD_DATA_SHIFT) & _BV(LCD_DATA3_PIN)) ? 0x08 : 0) )
+
+#define LCD_DATA_ONE_PORT   ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT ) )
+#define LCD_DATA_ADJACENT   ( (LCD_DATA_MASK >> LCD_DATA_SHIFT) == 0x0F )
+#define LCD_DATA_IN_ORDER   ( (LCD_DATA1_PIN == LCD_DATA0_PIN + 1) && (LCD_DATA2_PIN == LCD_DATA0_PIN + 2) && (LCD_DATA3_PIN == LCD_DATA0_PIN + 3) )
+
 #define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );
 #define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
 #define lcd_e_low()     LCD_E_PORT  &= ~_BV(LCD_E_PIN);
@@ -83,6 +107,27 @@
 static void toggle_e(void);
 #endif
 
+/*
+** local variables
+*/
+#if LCD_IO_MODE
+/* port bits for each nibble value */
+static const uint8_t lcd_nibble_to_port[16] PROGMEM = {
+    LCD_NIBBLE_TO_PORT(0),  LCD_NIBBLE_TO_PORT(1),  LCD_NIBBLE_TO_PORT(2),  LCD_NIBBLE_TO_PORT(3),
+    LCD_NIBBLE_TO_PORT(4),  LCD_NIBBLE_TO_PORT(5),  LCD_NIBBLE_TO_PORT(6),  LCD_NIBBLE_TO_PORT(7),
+    LCD_NIBBLE_TO_PORT(8),  LCD_NIBBLE_TO_PORT(9),  LCD_NIBBLE_TO_PORT(10), LCD_NIBBLE_TO_PORT(11),
+    LCD_NIBBLE_TO_PORT(12), LCD_NIBBLE_TO_PORT(13), LCD_NIBBLE_TO_PORT(14), LCD_NIBBLE_TO_PORT(15)
+};
+
+/* nibble value for each state of the (adjacent) data pins */
+static const uint8_t lcd_port_to_nibble[16] PROGMEM = {
+    LCD_PORT_TO_NIBBLE(0),  LCD_PORT_TO_NIBBLE(1),  LCD_PORT_TO_NIBBLE(2),  LCD_PORT_TO_NIBBLE(3),
+    LCD_PORT_TO_NIBBLE(4),  LCD_PORT_TO_NIBBLE(5),  LCD_PORT_TO_NIBBLE(6),  LCD_PORT_TO_NIBBLE(7),
+    LCD_PORT_TO_NIBBLE(8),  LCD_PORT_TO_NIBBLE(9),  LCD_PORT_TO_NIBBLE(10), LCD_PORT_TO_NIBBLE(11),
+    LCD_PORT_TO_NIBBLE(12), LCD_PORT_TO_NIBBLE(13), LCD_PORT_TO_NIBBLE(14), LCD_PORT_TO_NIBBLE(15)
+};
+#endif
+
 /*
 ** local functions
 */
@@ -114,6 +159,29 @@ the number of loops is calculated at compile-time from MCU clock frequency
 
 
 #if LCD_IO_MODE
+/* port bits for nibble n, data pins on one port */
+static inline uint8_t lcd_nibble_bits(uint8_t n)
+{
+    if ( LCD_DATA_IN_ORDER )
+        return n << LCD_DATA_SHIFT;
+    else
+        return pgm_read_byte(&lcd_nibble_to_port[n]);
+}
+
+
+/* nibble shown by the port input bits, data pins on one port */
+static inline uint8_t lcd_bits_nibble(uint8_t bits)
+{
+    if ( LCD_DATA_IN_ORDER )
+        return (bits >> LCD_DATA_SHIFT) & 0x0F;
+    else if ( LCD_DATA_ADJACENT )
+        return pgm_read_byte(&lcd_port_to_nibble[(bits >> LCD_DATA_SHIFT) & 0x0F]);
+    else
+        return ( (bits & _BV(LCD_DATA0_PIN)) ? 0x01 : 0 ) | ( (bits & _BV(LCD_DATA1_PIN)) ? 0x02 : 0 )
+             | ( (bits & _BV(LCD_DATA2_PIN)) ? 0x04 : 0 ) | ( (bits & _BV(LCD_DATA3_PIN)) ? 0x08 : 0 );
+}
+
+
 /* toggle Enable Pin to initiate write */
 static void toggle_e(void)
 {
@@ -144,23 +212,22 @@ static void lcd_write(uint8_t data,uint8_t rs)
     }
     lcd_rw_low();
 
-    if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
-      && (LCD_DATA0_PIN == 0) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    if ( LCD_DATA_ONE_PORT )
     {
         /* configure data pins as output */
-        DDR(LCD_DATA0_PORT) |= 0x0F;
+        DDR(LCD_DATA0_PORT) |= LCD_DATA_MASK;
 
         /* output high nibble first */
-        dataBits = LCD_DATA0_PORT & 0xF0;
-        LCD_DATA0_PORT = dataBits |((data>>4)&0x0F);
+        dataBits = LCD_DATA0_PORT & ~LCD_DATA_MASK;
+        LCD_DATA0_PORT = dataBits | lcd_nibble_bits(data>>4);
         lcd_e_toggle();
 
         /* output low nibble */
-        LCD_DATA0_PORT = dataBits | (data&0x0F);
+        LCD_DATA0_PORT = dataBits | lcd_nibble_bits(data&0x0F);
         lcd_e_toggle();
 
         /* all data pins high (inactive) */
-        LCD_DATA0_PORT = dataBits | 0x0F;
+        LCD_DATA0_PORT = dataBits | LCD_DATA_MASK;
     }
     else
     {
@@ -224,21 +291,20 @@ static uint8_t lcd_read(uint8_t rs)
         lcd_rs_low();                        /* RS=0: read busy flag */
     lcd_rw_high();                           /* RW=1  read mode      */
     
-    if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
-      && ( LCD_DATA0_PIN == 0 )&& (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    if ( LCD_DATA_ONE_PORT )
     {
-        DDR(LCD_DATA0_PORT) &= 0xF0;         /* configure data pins as input */
+        DDR(LCD_DATA0_PORT) &= ~LCD_DATA_MASK;   /* configure data pins as input */
         
         lcd_e_high();
         lcd_e_delay();        
-        data = PIN(LCD_DATA0_PORT) << 4;     /* read high nibble first */
+        data = lcd_bits_nibble(PIN(LCD_DATA0_PORT)) << 4;    /* read high nibble first */
         lcd_e_low();
         
         lcd_e_delay();                       /* Enable 500ns low       */
         
         lcd_e_high();
         lcd_e_delay();
-        data |= PIN(LCD_DATA0_PORT)&0x0F;    /* read low nibble        */
+        data |= lcd_bits_nibble(PIN(LCD_DATA0_PORT));        /* read low nibble        */
         lcd_e_low();
     }
     else
@@ -510,6 +576,29 @@ void lcd_puts_p(const char *progmem_s)
 }/* lcd_puts_p */
 
 
+/*************************************************************************
+Write bytes from program memory into the character generator RAM
+Input:    addr          CGRAM address of the first byte (8 * character + row)
+          progmem_data  bytes from program memory to write
+          len           number of bytes to write
+Returns:  none
+The cursor is returned to the DDRAM address it had before the call, so
+output continues where it left off.
+*************************************************************************/
+void lcd_cgram_p(uint8_t addr, const uint8_t *progmem_data, uint8_t len)
+{
+    uint8_t ddramAddress;
+
+    ddramAddress = lcd_waitbusy();      /* read busy-flag and address counter */
+    lcd_command((1<<LCD_CGRAM)+(addr & 0x3F));
+    while ( len-- ) {
+        lcd_data(pgm_read_byte(progmem_data++));
+    }
+    lcd_command((1<<LCD_DDRAM)+ddramAddress);
+
+}/* lcd_cgram_p */
+
+
 /*************************************************************************
 Initialize display and select type of cursor 
 Input:    dispAttr LCD_DISP_OFF            display off
@@ -238,6 +238,19 @@ extern void lcd_puts(const char *s);
 extern void lcd_puts_p(const char *progmem_s);
 
 
+/**
+ @brief    Write bytes from program memory into the character generator RAM
+
+ Characters 0..7 (and their aliases 8..15) show the pattern stored at CGRAM
+ address 8*character, one byte per pixel row. The cursor position is preserved.
+ @param    addr CGRAM address of the first byte to write
+ @param    progmem_data bytes from program memory to write
+ @param    len number of bytes to write
+ @return   none
+*/
+extern void lcd_cgram_p(uint8_t addr, const uint8_t *progmem_data, uint8_t len);
+
+
 /**
  @brief    Send LCD controller instruction command
  @param    cmd instruction to send to LCD controller, see HD44780 data sheet
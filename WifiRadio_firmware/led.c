@@ -0,0 +1,74 @@
+/*
+ * Activity LED, see led.h
+ */
+
+//=========== Includes ===========
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "led.h"
+
+//=========== Defines ===========
+
+#define	LED_BIT			5		// PC5
+
+//=========== Local variables ===========
+
+static unsigned char flashBits;			// Steps of the flash pattern still to show
+static BOOL flashIsError;				// The flash pattern playing is LED_ERROR
+static unsigned char backgroundBits;	// The background pattern
+static unsigned char backgroundStep;	// Step of the background pattern shown next
+
+//=========== Public functions ===========
+
+// Make the LED pin an output
+void ledInit(void)
+{
+	DDRC |= (1 << LED_BIT);
+}
+
+// Play a pattern once. An error pattern is never cut short by another one.
+void ledFlash(unsigned char pattern)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if(!(flashIsError && flashBits))
+		{
+			flashBits = pattern;
+			flashIsError = (pattern == LED_ERROR);
+		}
+	}
+}
+
+// Set the pattern to repeat when no flash is playing
+void ledBackground(unsigned char pattern)
+{
+	backgroundBits = pattern;
+}
+
+// Advance the patterns by one step. Called every 100 ms.
+void ledTick(void)
+{
+	BOOL on;
+
+	if(flashBits)
+	{
+		on = flashBits & 1;
+		flashBits >>= 1;
+	}
+	else
+	{
+		on = (backgroundBits >> backgroundStep) & 1;
+	}
+	backgroundStep = (backgroundStep + 1) & 7;
+
+	if(on)
+	{
+		PORTC |= (1 << LED_BIT);
+	}
+	else
+	{
+		PORTC &= ~(1 << LED_BIT);
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * Activity LED on PC5.
+ *
+ * The LED shows 8-step patterns, one step per timer tick (100 ms), least
+ * significant bit first. A flash pattern plays once and then gives way to the
+ * background pattern, which repeats until it is changed. Everything runs from
+ * ledTick(), so showing activity never holds up the rest of the firmware.
+ */
+
+#ifndef LED_H
+#define LED_H
+
+#include "common.h"
+
+// Flash patterns
+#define	LED_RX			0x01	// A line was received: one flash
+#define	LED_TX			0x05	// A command was sent: two flashes
+#define	LED_ERROR		0x55	// Link error or reply timeout: four flashes, not interrupted by the others
+
+// Background patterns
+#define	LED_OFF			0x00
+#define	LED_WAITING		0x11	// Waiting for a reply from the router: a flash every 400 ms
+
+void ledInit(void);
+void ledFlash(unsigned char pattern);
+void ledBackground(unsigned char pattern);
+void ledTick(void);
+
+#endif
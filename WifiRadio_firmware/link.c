@@ -0,0 +1,213 @@
+/*
+ * Reliable delivery of commands to the router, see link.h
+ */
+
+//=========== Includes ===========
+
+#include <string.h>
+
+#include "link.h"
+#include "serial.h"
+#include "sched.h"
+#include "led.h"
+
+//=========== Defines ===========
+
+#define	LINK_SEQ_MOD		10		// Sequence numbers are a single digit
+
+//=========== Global variables ===========
+
+unsigned int gLinkRetries;
+unsigned int gLinkFailures;
+
+//=========== Local variables ===========
+
+static char queue[LINK_QUEUE_LEN][LINK_FRAME_LEN];	// Frames waiting for an ack, the first one is on the wire
+static unsigned char queueLen[LINK_QUEUE_LEN];		// Length of each frame
+static unsigned char queueHead;						// Frame on the wire
+static unsigned char queueCount;					// Frames in the queue
+static unsigned char nextSeq;						// Sequence number of the next frame queued
+
+static unsigned char tries;			// Times the frame on the wire was sent
+static unsigned int sentAt;			// Tick at which it was last sent
+static unsigned int timeout;		// Ticks to wait for its ack
+static unsigned int lastAck;		// Tick at which the last ack came in
+static BOOL failed;					// A frame was given up since linkFailed() was last called
+static RttEstimate linkRtt;			// Round trip time of frames and their acks
+
+//=========== Local functions ===========
+
+// Send the frame at the head of the queue (again)
+static void transmit(void)
+{
+	putbytes(queue[queueHead], queueLen[queueHead]);	// If this fails, the retransmission will take care of it
+	ledFlash(LED_TX);
+	tries++;
+	sentAt = schedNow();
+}
+
+// Send the frame at the head of the queue for the first time
+static void startFrame(void)
+{
+	timeout = rttTimeout(&linkRtt, LINK_RTO_INITIAL);
+	if(timeout < LINK_RTO_MIN)
+	{
+		timeout = LINK_RTO_MIN;
+	}
+	if(timeout > LINK_RTO_MAX)
+	{
+		timeout = LINK_RTO_MAX;
+	}
+	tries = 0;
+	transmit();
+}
+
+// Done with the frame at the head of the queue, start on the next one
+static void nextFrame(void)
+{
+	queueHead = (queueHead + 1) % LINK_QUEUE_LEN;
+	queueCount--;
+
+	if(queueCount)
+	{
+		startFrame();
+	}
+}
+
+//=========== Public functions ===========
+
+// Queue a command frame ("cmd:<verb> [params]\n") for reliable delivery. The
+// frame is numbered, and sent right away if nothing else is waiting for an
+// ack. Returns FALSE if the queue is full.
+BOOL linkSend(const char *frame, unsigned char len)
+{
+	if(queueCount == LINK_QUEUE_LEN || len < 4 || len >= LINK_FRAME_LEN)
+	{
+		gLinkFailures++;
+		return FALSE;
+	}
+
+	// "cmd:" becomes "cmd<seq>:"
+	unsigned char slot = (queueHead + queueCount) % LINK_QUEUE_LEN;
+	memcpy(queue[slot], frame, 3);
+	queue[slot][3] = '0' + nextSeq;
+	memcpy(queue[slot] + 4, frame + 3, len - 3);
+	queueLen[slot] = len + 1;
+	nextSeq = (nextSeq + 1) % LINK_SEQ_MOD;
+
+	if(++queueCount == 1)
+	{
+		startFrame();
+	}
+
+	return TRUE;
+}
+
+// Handle an "ack: <seq>" line from the router. Returns FALSE for any other
+// line, which is then up to the caller.
+BOOL linkReceive(const char *line)
+{
+	if(strncmp_P(line, PSTR("ack: "), 5))
+	{
+		return FALSE;
+	}
+
+	// Acks for frames that were already acknowledged (or given up) are ignored
+	if(queueCount && line[5] == queue[queueHead][3])
+	{
+		lastAck = schedNow();
+		if(tries == 1)
+		{
+			rttSample(&linkRtt, lastAck - sentAt);
+		}
+		nextFrame();
+	}
+
+	return TRUE;
+}
+
+// Resend the frame on the wire when its ack is overdue, or give up on it.
+// Should run every few ms.
+void linkTask(void)
+{
+	if(!queueCount || schedNow() - sentAt < timeout)
+	{
+		return;
+	}
+
+	if(tries >= LINK_MAX_TRIES)
+	{
+		gLinkFailures++;
+		failed = TRUE;
+		nextFrame();
+		return;
+	}
+
+	gLinkRetries++;
+	timeout = timeout * 2 < LINK_RTO_MAX ? timeout * 2 : LINK_RTO_MAX;
+	transmit();
+}
+
+// Check whether any frames are still waiting for an ack
+BOOL linkBusy(void)
+{
+	return queueCount != 0;
+}
+
+// Check whether a frame was given up since the last call
+BOOL linkFailed(void)
+{
+	BOOL result = failed;
+
+	failed = FALSE;
+	return result;
+}
+
+// Tick at which the last ack came in
+unsigned int linkLastAck(void)
+{
+	return lastAck;
+}
+
+// Add a measurement to a round trip time estimate. The scaling makes the
+// smoothing gains of 1/8 (time) and 1/4 (deviation) additions and shifts.
+void rttSample(RttEstimate *rtt, unsigned int sample)
+{
+	if(sample > LINK_RTO_MAX)
+	{
+		sample = LINK_RTO_MAX;		// Keeps the scaled values within 16 bits
+	}
+	if(sample == 0)
+	{
+		sample = 1;
+	}
+
+	if(!rtt->srtt8)
+	{
+		rtt->srtt8 = sample << 3;
+		rtt->rttvar4 = sample << 1;
+	}
+	else
+	{
+		int error = sample - (rtt->srtt8 >> 3);
+
+		rtt->srtt8 += error;
+		if(error < 0)
+		{
+			error = -error;
+		}
+		rtt->rttvar4 += error - (rtt->rttvar4 >> 2);
+	}
+}
+
+// Timeout for the next exchange measured by an estimate: SRTT + 4 * RTTVAR,
+// or the given initial value while there are no measurements yet
+unsigned int rttTimeout(const RttEstimate *rtt, unsigned int initial)
+{
+	if(!rtt->srtt8)
+	{
+		return initial;
+	}
+
+	return (rtt->srtt8 >> 3) + rtt->rttvar4;
+}
@@ -0,0 +1,52 @@
+/*
+ * Reliable delivery of commands to the router.
+ *
+ * Every command frame gets a sequence number ("cmd3:next" instead of
+ * "cmd:next"), and the router answers each one with "ack: 3". Frames are sent
+ * one at a time from a small queue; a frame that is not acknowledged within
+ * the retransmission timeout is sent again, with the timeout doubled, until
+ * it is given up after LINK_MAX_TRIES attempts. The router ignores a frame
+ * with the same number as the one before it (apart from hello), so a frame
+ * whose ack was lost is not executed twice.
+ *
+ * The retransmission timeout follows the measured round trip times, as in
+ * TCP: SRTT + 4 * RTTVAR, from smoothed estimates of the round trip time and
+ * its variation. Only frames that got through at the first attempt are
+ * measured, as it is unknown which attempt an ack for a resent frame belongs
+ * to. The same estimator is available for other timeouts, e.g. the time the
+ * router takes to reply to a request.
+ */
+
+#ifndef LINK_H
+#define LINK_H
+
+#include "common.h"
+
+#define	LINK_QUEUE_LEN		4		// Frames that can wait for transmission
+#define	LINK_FRAME_LEN		40		// Longest frame, sequence number and newline included
+#define	LINK_MAX_TRIES		5		// Attempts before a frame is given up
+#define	LINK_RTO_INITIAL	1000	// Retransmission timeout before the first measurement, in ms
+#define	LINK_RTO_MIN		100		// Bounds of the retransmission timeout, in ms
+#define	LINK_RTO_MAX		4000
+
+// Smoothed round trip time estimate, scaled as in TCP to keep the fractions
+typedef struct
+{
+	unsigned int srtt8;		// Smoothed round trip time * 8, in ms; 0 before the first sample
+	unsigned int rttvar4;	// Smoothed mean deviation * 4, in ms
+} RttEstimate;
+
+extern unsigned int gLinkRetries;		// Frames sent again because their ack did not come in time
+extern unsigned int gLinkFailures;		// Frames given up, or dropped because the queue was full
+
+BOOL linkSend(const char *frame, unsigned char len);
+BOOL linkReceive(const char *line);
+void linkTask(void);
+BOOL linkBusy(void);
+BOOL linkFailed(void);
+unsigned int linkLastAck(void);
+
+void rttSample(RttEstimate *rtt, unsigned int sample);
+unsigned int rttTimeout(const RttEstimate *rtt, unsigned int initial);
+
+#endif
@@ -19,96 +19,220 @@
 #include <avr/interrupt.h>
 #include <util/delay.h>
 #include <string.h>
-#include <stdio.h>
 
 #include "lcd.h"				// Peter Fleury's LCD Library
+#include "common.h"
+#include "parse.h"
+#include "serial.h"
+#include "format.h"
+#include "glyph.h"
+#include "screen.h"
+#include "led.h"
+#include "sched.h"
+#include "link.h"
+#include "buttons.h"
 
 //=========== Defines ===========
 
-#define	SER_BUFF_LEN	200		// longest character line to accept from serial port
-#define STR_LEN			21		// Longest substring (artist, trackname) to accept. Width of the display + terminating 0
-#define	BAUD			9600	// USART baud rate, must agree with router ttyS0 settings
-#define	LCD_WIDTH		20		// visible width of LCD display
 #define	PAGEDELAY		3000	// delay between LCD pages, in ms
+#define	TICKS_PER_SECOND	10	// Runs of uiTask() per second
 
-#define BOOL unsigned char
-#define TRUE 1
-#define FALSE 0
-
-#define UPBUTTON 0
-#define DOWNBUTTON 1
-#define LEFTBUTTON 2
-#define RIGHTBUTTON 3
-#define ENTERBUTTON 4
-#define SWITCHBUTTON 5
-
-#define UPBUTTONPIN PINB&4
-#define DOWNBUTTONPIN PIND&128
-#define LEFTBUTTONPIN PINB&2
-#define RIGHTBUTTONPIN PIND&32
-#define ENTERBUTTONPIN PIND&64
-#define SWITCHBUTTONPIN PINB&1
+#define	VOLUME_STEP			5	// Volume change per button press, in percent
+#define	VOLUME_SETTLE_TICKS	4	// Quiet time after the last volume press before the new volume is sent
+#define	VOLUME_OVERLAY_TICKS	20	// How long the volume bar stays on the display after the last press
+#define	JUMP_SETTLE_TICKS	5	// Quiet time after the last next/prev press before the jump is sent
+#define	JUMP_HOLD_TICKS		30	// How long to ignore the router reporting the old song after a jump was sent
+#define	QUEUE_SKIP_PARTS	10	// Right in the queue view skips ahead by this fraction of the queue
+#define	REPLY_TIMEOUT_INITIAL	2000	// Time the router gets to reply to an acknowledged request before it is measured, in ms
+#define	REPLY_TIMEOUT_MIN	500		// Bounds of the reply timeout, in ms
+#define	REPLY_TIMEOUT_MAX	5000
+#define	SPECTRUM_TIMEOUT	1000	// A spectrum older than this is no longer shown, in ms
+#define	BROWSE_DEPTH		2		// Parent directories whose page is kept for going back up, 90 bytes each
+#define	STATS_PAIR_LEN		12		// Longest " <wcet> <misses>" of a task in cmd:stats
+#define	STATS_TAIL_LEN		6		// Longest " <stack>\n" ending cmd:stats; 2 KB of SRAM is 4 digits
 
 #define PM_PLAYING 0
+#define PM_QUEUE 1
 #define PM_BROWSING 2
 
-//=========== Function prototypes ===========
+// Pages of the playing screen, shown in turn for PAGEDELAY each. The first and
+// last lines (time and progress) stay the same, the pages fill the middle two.
+#define PAGE_NOW_PLAYING	0
+#define PAGE_NEXT_UP		1
+#define PAGE_FORMAT			2
+#define PAGE_QUEUE			3
+#define PAGE_CLOCK			4
+#define NUM_PAGES			5
+#define PAGE_TICKS			(PAGEDELAY / (1000 / TICKS_PER_SECOND))
 
-int atoi ( const char * str );
+//=========== Function prototypes ===========
 
-void inituart(void);
-void ioinit(void);
-void uart_putchar(unsigned char data);
-unsigned char uart_getchar(void);
-void uart_flush(void);
-void getline(char *serbuffer);
-void putstring(char *buffer);
-void init_timer1(void);
+void uiTask(void);
+void serialTask(void);
+void displayTask(void);
+void sendStats(void);
 
-void lcd_print(char *s);
-void processPlayingLine(char *RXserbuffer, char *artist, char *title, int *playlistLength, int *songNum, int *songTime, int *songElapsed);
-void displayTime(int songElapsed, int playlistLength, int songNum);
+void updatePlayerStatus(const char *line);
+void displayPlayingScreen(void);
+BOOL pageAvailable(unsigned char page, const PlayerStatus *status);
+void displayPage(unsigned char page, const PlayerStatus *status);
+void displayTime(const PlayerStatus *status);
+void displayBigTime(int songElapsed);
 void displayProgressBar(int songLength, int songElapsed);
-void displayTrackInfo(char *trackName, char *artistName);
+char *renderBar(char *dest, unsigned char cells, long value, long maxValue, unsigned char line);
+void displayTrackInfo(const char *trackName, const char *artistName);
+void displayNextUp(const PlayerStatus *status);
+void displayFormat(const PlayerStatus *status);
+void displayQueue(const PlayerStatus *status);
 void displayDirEntries(void);
-BOOL processButtonPress(int buttonIndex, int buttonPin);
-BOOL processResponse(char *RXserbuffer);
-void sendCommand(char* command);
-void sendCommandParams(char* cmd, int param1, int param2);
-
-char serRXbuffer[SER_BUFF_LEN];	// serial buffer
-char serTXbuffer[20];	// serial buffer
+void sendCommand(PGM_P command);
+unsigned int replyTimeout(void);
+void sendCommandParams(PGM_P cmd, int param1, int param2);
+void sendCommandParam(PGM_P cmd, int param);
+void changeVolume(int delta);
+void changeSong(int delta);
+void selectSong(int songNum);
+void processQueueButtons(void);
+void requestQueue(PGM_P cmd);
+void displayVolume(int volume);
+void setPlayerMode(unsigned char mode);
+void updateTopics(void);
+void sendHello(void);
+void displaySpectrum(void);
+void enterDirectory(void);
+void leaveDirectory(void);
 
 
 //=========== Global Variables ===========
 
-unsigned char gButtonPressSeen;	// Bits used to keep track of which button presses have been seen
 unsigned char gPlayerMode;		// Keep track whether we are playing something or browsing the collection
+unsigned char gTopics;			// Topics the router was last asked to push, see TOPIC_TRACK in parse.h
 int gCurrentListSelectedIndex;	// The selected item in the sublist of 4 currently shown on the display
 int gCurrentListStartIndex;		// The index in the total list of the first item in the current sublist of 4
-char gDirEntries[4][STR_LEN];	// Buffer holding track/dir names to display in browsing mode
+char gDirEntries[MAX_DIR_ENTRIES][STR_LEN];	// Buffer holding track/dir names to display in browsing mode
 int gNumDirEntries;				// How many dir entries did I receive? (should always be 1,2,3 or 4)
 BOOL gWaitingForReply;			// Indicates whether a request was sent to which a reply is expected but not yet received
-int gTimeOutCounter;			// Counter for the response timeout mechanism (in case the router fails to respond)
+BOOL gRedrawDirEntries;			// Set by the button handler when the browse list needs to be redrawn
+RttEstimate gReplyTime;			// Time from the ack of a request to its reply, for the reply timeout
+unsigned int gLastLinkErrors;	// Sum of the serial error counters when last checked
+PlayerStatus gStatus;			// What is currently playing. The elapsed time is advanced locally by the timer
+unsigned char gClockTicks;		// Timer ticks since the elapsed time was last advanced
+BOOL gRedrawPlaying;			// The player status changed, redraw the complete playing screen
+BOOL gRedrawTime;				// The local clock advanced, redraw the time and the progress bar
+BOOL gRedrawVolume;				// The volume was changed locally, show the volume bar
+unsigned char gPage;			// Page of the playing screen currently shown
+unsigned char gPageTicks;		// Ticks the current page has been shown
+unsigned char gVolumeSettleTicks;	// Ticks left before a locally changed volume is sent to the router
+unsigned char gVolumeOverlayTicks;	// Ticks left before the volume bar makes way for the progress bar again
+unsigned char gJumpSettleTicks;	// Ticks left before a locally selected song is sent to the router
+unsigned char gJumpHoldTicks;	// Ticks left during which the router may still report the song we jumped away from
+unsigned char gSpectrum[SPECTRUM_BARS];	// Bar heights of the last spectrum received
+unsigned int gSpectrumTime;		// Tick at which it was received
+BOOL gSpectrumFresh;			// It was received less than SPECTRUM_TIMEOUT ago
+BOOL gRedrawSpectrum;			// A new spectrum was received
 
-// Timer1 overflow interrupt service routine (ISR)
-SIGNAL (TIMER1_OVF_vect) // SIGNAL call makes sure we don't interrupt the interrupt
+// A parent directory of the one being browsed, as it was left
+typedef struct
 {
-	TCNT1 = 0x10000 - (F_CPU/1024/10);	// Reset the timer
-	
+	int startIndex;
+	int selectedIndex;
+	int numEntries;
+	char entries[MAX_DIR_ENTRIES][STR_LEN];
+} Breadcrumb;
+
+Breadcrumb gBreadcrumbs[BROWSE_DEPTH];	// Ring of the nearest parents, the nearest one just before gBreadcrumbTop
+unsigned char gBreadcrumbTop;	// Slot for the next breadcrumb
+unsigned char gNumBreadcrumbs;	// Breadcrumbs in the ring. Further down, the farthest ones make way.
+
+// Task that runs TICKS_PER_SECOND times per second: the local clock, the
+// settle and overlay timers, page rotation, the LED and the buttons
+void uiTask(void)
+{
+	// Local playback clock. While playing, the elapsed time advances once per
+	// second without any help from the router, which only resynchronizes it
+	// on song changes, seeks and the occasional keyframe. The clock stops at
+	// the end of the song until the router reports the next one.
+	if(++gClockTicks >= TICKS_PER_SECOND)
+	{
+		gClockTicks = 0;
+		if(gStatus.state == STATE_PLAY && (gStatus.songTime == 0 || gStatus.songElapsed < gStatus.songTime))
+		{
+			gStatus.songElapsed++;
+			gRedrawTime = TRUE;
+		}
+	}
+
+	// Volume presses are applied locally right away, and sent to the router as
+	// a single absolute volume once the presses have stopped for a while
+	if(gVolumeSettleTicks && --gVolumeSettleTicks == 0)
+	{
+		sendCommandParam(PSTR("setvol"), gStatus.volume);
+	}
+
+	if(gVolumeOverlayTicks && --gVolumeOverlayTicks == 0)
+	{
+		gRedrawTime = TRUE;		// Bring back the progress bar
+	}
+
+	// When the spectrum stops coming (e.g. the stream stopped), clear it
+	if(gSpectrumFresh && schedNow() - gSpectrumTime >= SPECTRUM_TIMEOUT)
+	{
+		gSpectrumFresh = FALSE;
+		gRedrawTime = TRUE;
+	}
+
+	// Page rotation of the playing screen. Pages with nothing to show (no next
+	// song, no audio format while stopped, ...) are skipped.
+	if(gPlayerMode == PM_PLAYING && ++gPageTicks >= PAGE_TICKS)
+	{
+		gPageTicks = 0;
+		for(unsigned char i=1; i<NUM_PAGES; i++)
+		{
+			unsigned char page = (gPage + i) % NUM_PAGES;
+			if(pageAvailable(page, &gStatus))
+			{
+				gPage = page;
+				gRedrawPlaying = TRUE;
+				break;
+			}
+		}
+	}
+
+	// Same for next/prev: a burst of presses becomes a single jump
+	if(gJumpSettleTicks && --gJumpSettleTicks == 0)
+	{
+		sendCommandParam(PSTR("jump"), gStatus.songNum);
+		gJumpHoldTicks = JUMP_HOLD_TICKS;
+	}
+	else if(gJumpHoldTicks)
+	{
+		gJumpHoldTicks--;
+	}
+
 	// Timeout mechanism, just in case the router fails to respond to a button press for 
-	// which I expect a reply
-	if(gWaitingForReply && gTimeOutCounter < 20)
+	// which I expect a reply. The request itself is resent by the link until the
+	// router acknowledges it (or the link gives up); after that, the router gets
+	// as long to reply as its replies have been taking lately.
+	if(linkFailed())
 	{
-		gTimeOutCounter++;
+		gWaitingForReply = FALSE;
 	}
-	else
+	else if(gWaitingForReply && !linkBusy() && schedNow() - linkLastAck() > replyTimeout())
 	{
-		// Timeout occurred
+		ledFlash(LED_ERROR);
 		gWaitingForReply = FALSE;
-		gTimeOutCounter=0;
 	}
 	
+	// Any new link error is shown on the LED
+	unsigned int linkErrors = serialErrors() + gLinkFailures;
+	if(linkErrors != gLastLinkErrors)
+	{
+		gLastLinkErrors = linkErrors;
+		ledFlash(LED_ERROR);
+	}
+	ledBackground(gWaitingForReply ? LED_WAITING : LED_OFF);
+	ledTick();
+
 	// Don't process button presses while I am are waiting for a reply
 	if(!gWaitingForReply)
 	{
@@ -117,31 +241,46 @@ SIGNAL (TIMER1_OVF_vect) // SIGNAL call makes sure we don't interrupt the interr
 		{
 			if(processButtonPress(UPBUTTON, UPBUTTONPIN) == TRUE)
 			{
-				sendCommand("cmd:volup\n");  
+				changeVolume(VOLUME_STEP);
 			}
 			if(processButtonPress(DOWNBUTTON, DOWNBUTTONPIN) == TRUE)
 			{
-				sendCommand("cmd:voldown\n");
+				changeVolume(-VOLUME_STEP);
 			}
 			if(processButtonPress(LEFTBUTTON, LEFTBUTTONPIN) == TRUE)
 			{
-				sendCommand("cmd:prev\n");
+				changeSong(-1);
 			}
 			if(processButtonPress(RIGHTBUTTON, RIGHTBUTTONPIN) == TRUE)
 			{
-				sendCommand("cmd:next\n");
+				changeSong(1);
+			}
+			if(processButtonPress(ENTERBUTTON, ENTERBUTTONPIN) == TRUE && gStatus.playlistLength > 0)
+			{
+				setPlayerMode(PM_QUEUE);
+
+				// Open the queue at the page holding the current song
+				int current = gStatus.songNum > 0 ? gStatus.songNum - 1 : 0;
+				gCurrentListStartIndex = current - current % MAX_DIR_ENTRIES;
+				gCurrentListSelectedIndex = current % MAX_DIR_ENTRIES;
+				requestQueue(PSTR("getqueue"));
 			}
 			if(processButtonPress(SWITCHBUTTON, SWITCHBUTTONPIN) == TRUE)
 			{
-				gPlayerMode = PM_BROWSING;
+				setPlayerMode(PM_BROWSING);
 
 				// Retrieve the first list of items to show
 				gCurrentListStartIndex = 0;
 				gCurrentListSelectedIndex = 0;
-				sendCommand("cmd:getfirsttracks\n");  
+				gNumBreadcrumbs = 0;
+				sendCommand(PSTR("cmd:getfirsttracks\n"));  
 				gWaitingForReply = TRUE;
 			}
 		}
+		else if(gPlayerMode == PM_QUEUE)
+		{
+			processQueueButtons();
+		}
 		// When I am browsing, handle button presses accordingly
 		else if(gPlayerMode == PM_BROWSING)
 		{
@@ -162,12 +301,12 @@ SIGNAL (TIMER1_OVF_vect) // SIGNAL call makes sure we don't interrupt the interr
 					gCurrentListSelectedIndex = 3;
 					
 					// Retrieve the new list of items to show
-					sendCommandParams("gettracks", gCurrentListStartIndex, gCurrentListSelectedIndex);		
+					sendCommandParams(PSTR("gettracks"), gCurrentListStartIndex, gCurrentListSelectedIndex);		
 					gWaitingForReply = TRUE;
 				}
 				else
 				{
-					displayDirEntries();
+					gRedrawDirEntries = TRUE;
 				}
 			}
 				
@@ -185,7 +324,7 @@ SIGNAL (TIMER1_OVF_vect) // SIGNAL call makes sure we don't interrupt the interr
 					gCurrentListSelectedIndex = 0;
 					
 					// Retrieve the new list of items to show
-					sendCommandParams("gettracks", gCurrentListStartIndex, gCurrentListSelectedIndex);		
+					sendCommandParams(PSTR("gettracks"), gCurrentListStartIndex, gCurrentListSelectedIndex);		
 					gWaitingForReply = TRUE;
 				}	
 				else
@@ -196,96 +335,470 @@ SIGNAL (TIMER1_OVF_vect) // SIGNAL call makes sure we don't interrupt the interr
 						gCurrentListSelectedIndex = gNumDirEntries - 1;
 					}
 
-					displayDirEntries();
+					gRedrawDirEntries = TRUE;
 				}
 			}
 			
 			if(processButtonPress(LEFTBUTTON, LEFTBUTTONPIN) == TRUE)
 			{
-				sendCommand("cmd:dirup\n");
-				gCurrentListStartIndex = 0;
-				gCurrentListSelectedIndex = 0;
-				gWaitingForReply = TRUE;
+				leaveDirectory();
 			}
 			
 			if(processButtonPress(RIGHTBUTTON, RIGHTBUTTONPIN) == TRUE)
 			{
-				sendCommandParams("dirdown", gCurrentListStartIndex, gCurrentListSelectedIndex);		
-				gCurrentListStartIndex = 0;
-				gCurrentListSelectedIndex = 0;
-				gWaitingForReply = TRUE;
+				enterDirectory();
 			}
 			
 			if(processButtonPress(ENTERBUTTON, ENTERBUTTONPIN) == TRUE)
 			{
-				gPlayerMode = PM_PLAYING;
-				sendCommandParams("play", gCurrentListStartIndex, gCurrentListSelectedIndex);		
+				setPlayerMode(PM_PLAYING);
+				gPage = PAGE_NOW_PLAYING;
+				gPageTicks = 0;
+				gRedrawPlaying = TRUE;
+				sendCommandParams(PSTR("play"), gCurrentListStartIndex, gCurrentListSelectedIndex);		
 			}
 
 			if(processButtonPress(SWITCHBUTTON, SWITCHBUTTONPIN) == TRUE)
 			{
-				gPlayerMode = PM_PLAYING;
-				sendCommand("cmd:loadstreams\n");
+				setPlayerMode(PM_PLAYING);
+				gPage = PAGE_NOW_PLAYING;
+				gPageTicks = 0;
+				gRedrawPlaying = TRUE;
+				sendCommand(PSTR("cmd:loadstreams\n"));
 			}
 		}
 	}
 }
 
+// Go down into the selected entry. The page being left becomes a breadcrumb,
+// so going back up needs nothing from the router.
+void enterDirectory(void)
+{
+	Breadcrumb *crumb = &gBreadcrumbs[gBreadcrumbTop];
+
+	crumb->startIndex = gCurrentListStartIndex;
+	crumb->selectedIndex = gCurrentListSelectedIndex;
+	crumb->numEntries = gNumDirEntries;
+	memcpy(crumb->entries, gDirEntries, sizeof(gDirEntries));
+	gBreadcrumbTop = (gBreadcrumbTop + 1) % BROWSE_DEPTH;
+	if(gNumBreadcrumbs < BROWSE_DEPTH)
+	{
+		gNumBreadcrumbs++;
+	}
+
+	sendCommandParams(PSTR("dirdown"), gCurrentListStartIndex, gCurrentListSelectedIndex);
+	gCurrentListStartIndex = 0;
+	gCurrentListSelectedIndex = 0;
+	gWaitingForReply = TRUE;
+}
+
+// Go back up to the parent directory. With a breadcrumb, its page is shown
+// again right away at the entry it was left from, and the router only hears
+// where that is ("dirup <start> <selected>"). Without one (at the top, or
+// deeper down than BROWSE_DEPTH) the router lists the parent from the start.
+void leaveDirectory(void)
+{
+	if(!gNumBreadcrumbs)
+	{
+		sendCommand(PSTR("cmd:dirup\n"));
+		gCurrentListStartIndex = 0;
+		gCurrentListSelectedIndex = 0;
+		gWaitingForReply = TRUE;
+		return;
+	}
+
+	gBreadcrumbTop = (gBreadcrumbTop + BROWSE_DEPTH - 1) % BROWSE_DEPTH;
+	gNumBreadcrumbs--;
+
+	Breadcrumb *crumb = &gBreadcrumbs[gBreadcrumbTop];
+	gCurrentListStartIndex = crumb->startIndex;
+	gCurrentListSelectedIndex = crumb->selectedIndex;
+	gNumDirEntries = crumb->numEntries;
+	memcpy(gDirEntries, crumb->entries, sizeof(gDirEntries));
+	gRedrawDirEntries = TRUE;
+
+	sendCommandParams(PSTR("dirup"), gCurrentListStartIndex, gCurrentListSelectedIndex);
+}
+
 // Send a command with 2 parameters through the serial port 
-void sendCommandParams(char* cmd, int param1, int param2)
+void sendCommandParams(PGM_P cmd, int param1, int param2)
 {
 	char stringBuffer[40];
-	sprintf(stringBuffer, "cmd:%s %d %d\n", cmd, param1, param2);
-	sendCommand(stringBuffer);		
+	char *end = formatCommand(stringBuffer, cmd, param1, param2);
+	linkSend(stringBuffer, end - stringBuffer);
 }
 
-// Handle a button press. This returns TRUE when a new button press on the selected pin is detected 
-// Once a button press is detected, the function returns FALSE, until the button is released and 
-// pressed again
-BOOL processButtonPress(int buttonIndex, int buttonPin)
+// Send a command with 1 parameter through the serial port 
+void sendCommandParam(PGM_P cmd, int param)
 {
-	BOOL result = FALSE;
-	
-	if(!(gButtonPressSeen & (1 << buttonIndex)))
+	char stringBuffer[40];
+	char *end = formatCommandParam(stringBuffer, cmd, param);
+	linkSend(stringBuffer, end - stringBuffer);
+}
+
+// Switch to another mode, and have the router push only what that mode shows.
+// Browsing subscribes to nothing, so the replies to browse requests have the
+// serial line to themselves; the playing screen gets everything again in
+// full when it comes back.
+void setPlayerMode(unsigned char mode)
+{
+	gPlayerMode = mode;
+	updateTopics();
+}
+
+// Subscribe to what the current mode shows, if that changed. The spectrum
+// takes the place of the progress bar of a stream that is playing.
+void updateTopics(void)
+{
+	unsigned char topics;
+
+	switch(gPlayerMode)
+	{
+		case PM_QUEUE:		topics = TOPIC_QUEUE;	break;
+		case PM_BROWSING:	topics = 0;				break;
+		default:			topics = TOPIC_ALL;		break;
+	}
+
+	if(gPlayerMode == PM_PLAYING && gStatus.state == STATE_PLAY && gStatus.songTime == 0)
+	{
+		topics |= TOPIC_SPECTRUM;
+	}
+
+	if(topics != gTopics)
 	{
-		if(!(buttonPin))
+		gTopics = topics;
+		sendCommandParam(PSTR("sub"), topics);
+	}
+}
+
+// Ask the router to start over: it forgets what the string cache holds and
+// what was subscribed to. Then subscribe to what the current mode needs again.
+// The cache is emptied here as well, so a reference the router sent before it
+// got the hello cannot pick up a string it no longer means.
+void sendHello(void)
+{
+	clearStringCache();
+	sendCommand(PSTR("cmd:hello\n"));
+	gTopics = TOPIC_ALL;
+	updateTopics();
+}
+
+// Change the volume in response to a button press. The new volume is shown
+// immediately, but only sent to the router when no further presses follow
+// within VOLUME_SETTLE_TICKS, so a long sweep costs a single MPD command.
+void changeVolume(int delta)
+{
+	int volume = gStatus.volume + delta;
+
+	// Without a volume from the router there is nothing to step from
+	if(gStatus.volume == VOLUME_UNKNOWN)
+	{
+		return;
+	}
+
+	if(volume < 0)
+	{
+		volume = 0;
+	}
+	if(volume > 100)
+	{
+		volume = 100;
+	}
+
+	gStatus.volume = volume;
+	gVolumeSettleTicks = VOLUME_SETTLE_TICKS;
+	gVolumeOverlayTicks = VOLUME_OVERLAY_TICKS;
+	gRedrawVolume = TRUE;
+}
+
+// Move through the playlist in response to a button press. Like the volume,
+// the new position is shown right away and sent to the router as a single
+// jump once the presses stop, so skipping five songs (or radio stations)
+// costs one MPD command and one stream reconnect instead of five.
+void changeSong(int delta)
+{
+	int songNum = gStatus.songNum + delta;
+
+	// An empty playlist has no song to move to
+	if(gStatus.playlistLength == 0)
+	{
+		return;
+	}
+	if(songNum > gStatus.playlistLength)
+	{
+		songNum = gStatus.playlistLength;
+	}
+	if(songNum < 1)
+	{
+		songNum = 1;
+	}
+	if(songNum == gStatus.songNum)
+	{
+		return;
+	}
+
+	selectSong(songNum);
+	gJumpSettleTicks = JUMP_SETTLE_TICKS;
+}
+
+// Show the given song as the one playing, until the router confirms it. The
+// caller arranges for the jump to be sent.
+void selectSong(int songNum)
+{
+	// The title of the new song is not known until the router reports it
+	gStatus.songNum = songNum;
+	gStatus.songElapsed = 0;
+	gStatus.songTime = 0;
+	gStatus.artist[0] = '\0';
+	gStatus.title[0] = '\0';
+
+	gJumpHoldTicks = 0;
+	gPage = PAGE_NOW_PLAYING;
+	gPageTicks = 0;
+	gRedrawPlaying = TRUE;
+}
+
+// Handle the buttons in the queue view. Up/down move through the queue a song
+// at a time, right skips ahead by a tenth of the queue (wrapping around at the
+// end), enter plays the selected song, left removes it from the queue and the
+// mode switch returns to the playing screen.
+void processQueueButtons(void)
+{
+	if(processButtonPress(UPBUTTON, UPBUTTONPIN) == TRUE)
+	{
+		if(gCurrentListSelectedIndex > 0)
+		{
+			gCurrentListSelectedIndex--;
+			gRedrawDirEntries = TRUE;
+		}
+		else if(gCurrentListStartIndex > 0)
 		{
-			gButtonPressSeen |=  (1 << buttonIndex);
-			result=TRUE;
+			gCurrentListStartIndex -= MAX_DIR_ENTRIES;
+			gCurrentListSelectedIndex = MAX_DIR_ENTRIES - 1;
+			requestQueue(PSTR("getqueue"));
 		}
 	}
-	else
+
+	if(processButtonPress(DOWNBUTTON, DOWNBUTTONPIN) == TRUE)
 	{
-		if((buttonPin))
+		if(gCurrentListSelectedIndex < gNumDirEntries - 1)
 		{
-			gButtonPressSeen &=  !(1 << buttonIndex);
+			gCurrentListSelectedIndex++;
+			gRedrawDirEntries = TRUE;
+		}
+		else if(gCurrentListStartIndex + MAX_DIR_ENTRIES < gStatus.playlistLength)
+		{
+			gCurrentListStartIndex += MAX_DIR_ENTRIES;
+			gCurrentListSelectedIndex = 0;
+			requestQueue(PSTR("getqueue"));
 		}
-		
 	}
-	
-	return result;
+
+	if(processButtonPress(RIGHTBUTTON, RIGHTBUTTONPIN) == TRUE)
+	{
+		int skip = gStatus.playlistLength / QUEUE_SKIP_PARTS;
+
+		skip -= skip % MAX_DIR_ENTRIES;
+		if(skip < MAX_DIR_ENTRIES)
+		{
+			skip = MAX_DIR_ENTRIES;
+		}
+
+		gCurrentListStartIndex += skip;
+		if(gCurrentListStartIndex >= gStatus.playlistLength)
+		{
+			gCurrentListStartIndex = 0;
+		}
+		gCurrentListSelectedIndex = 0;
+		requestQueue(PSTR("getqueue"));
+	}
+
+	if(processButtonPress(LEFTBUTTON, LEFTBUTTONPIN) == TRUE && gNumDirEntries > 0)
+	{
+		// The router answers with the same page of the shortened queue
+		requestQueue(PSTR("delqueue"));
+	}
+
+	if(processButtonPress(ENTERBUTTON, ENTERBUTTONPIN) == TRUE && gNumDirEntries > 0)
+	{
+		selectSong(gCurrentListStartIndex + gCurrentListSelectedIndex + 1);
+		gJumpSettleTicks = 1;		// No more presses to wait for, send on the next tick
+		setPlayerMode(PM_PLAYING);
+	}
+
+	if(processButtonPress(SWITCHBUTTON, SWITCHBUTTONPIN) == TRUE)
+	{
+		setPlayerMode(PM_PLAYING);
+		gPage = PAGE_NOW_PLAYING;
+		gPageTicks = 0;
+		gRedrawPlaying = TRUE;
+	}
+}
+
+// Ask the router for the page of the queue starting at gCurrentListStartIndex
+void requestQueue(PGM_P cmd)
+{
+	sendCommandParams(cmd, gCurrentListStartIndex, gCurrentListSelectedIndex);
+	gWaitingForReply = TRUE;
 }
 
-// Send a string to the router through the serial port
-void sendCommand(char* command)
+// Send a command from flash to the router through the serial port
+void sendCommand(PGM_P command)
 {
-	sprintf(serTXbuffer, command);	// Place command in send buffer
-	putstring(serTXbuffer);	// transmit over serial link		
+	char stringBuffer[LINK_FRAME_LEN];
+
+	strncpy_P(stringBuffer, command, sizeof(stringBuffer) - 1);
+	stringBuffer[sizeof(stringBuffer) - 1] = '\0';
+	linkSend(stringBuffer, strlen(stringBuffer));	// queue for transmission over serial link
 }
 
-// Main function. Apart from some initialization, this function contains
-// and endless loop which handles messages received from the router over 
-// the serial line
+// Time to wait for the reply to an acknowledged request
+unsigned int replyTimeout(void)
+{
+	unsigned int timeout = rttTimeout(&gReplyTime, REPLY_TIMEOUT_INITIAL);
+
+	if(timeout < REPLY_TIMEOUT_MIN)
+	{
+		timeout = REPLY_TIMEOUT_MIN;
+	}
+	if(timeout > REPLY_TIMEOUT_MAX)
+	{
+		timeout = REPLY_TIMEOUT_MAX;
+	}
+	return timeout;
+}
+
+// Task that handles the lines received from the router. The scheduler runs it
+// every ms, so a complete line waits at most that long.
+void serialTask(void)
+{
+	// Grab a line of data from the serial port, if one is complete. Reception
+	// continues in the background while the line is being processed.
+	char *serRXbuffer = getline();
+
+	if(!serRXbuffer)
+	{
+		return;
+	}
+
+	// Blink once when a message was received. The LED is timed by uiTask(),
+	// so the next line can be read right away.
+	ledFlash(LED_RX);
+
+	// Acks are for the link
+	if(linkReceive(serRXbuffer))
+	{
+		releaseline();
+		return;
+	}
+
+	// If I am browsing or looking at the queue, this should be the response
+	// to my last request. Track info is processed in every mode, so the
+	// playing screen is up to date as soon as I return to it.
+	if(!strcmp_P(serRXbuffer, PSTR("stats?")))
+	{
+		sendStats();
+	}
+	else if(!strcmp_P(serRXbuffer, PSTR("bootloader")))
+	{
+		startBootloader();
+	}
+	else if(processSpectrumLine(serRXbuffer, gSpectrum))
+	{
+		gSpectrumTime = schedNow();
+		gSpectrumFresh = TRUE;
+		gRedrawSpectrum = TRUE;
+	}
+	else if((gPlayerMode == PM_BROWSING || gPlayerMode == PM_QUEUE) && processResponse(serRXbuffer, gDirEntries, &gNumDirEntries) == TRUE)
+	{
+		// The list may have become shorter, e.g. after a delete
+		if(gCurrentListSelectedIndex >= gNumDirEntries && gNumDirEntries > 0)
+		{
+			gCurrentListSelectedIndex = gNumDirEntries - 1;
+		}
+		if(gWaitingForReply && !linkBusy())
+		{
+			rttSample(&gReplyTime, schedNow() - linkLastAck());
+		}
+		gWaitingForReply = FALSE;
+		gRedrawDirEntries = TRUE;
+	}
+	else
+	{
+		updatePlayerStatus(serRXbuffer);
+	}
+
+	releaseline();
+}
+
+// Task that brings the display up to date. The screen is composed in RAM
+// as a whole, and only the characters that changed reach the display.
+void displayTask(void)
+{
+	if(gPlayerMode == PM_PLAYING && (gRedrawPlaying || gRedrawTime || gRedrawVolume))
+	{
+		gRedrawPlaying = FALSE;
+		gRedrawTime = FALSE;
+		gRedrawVolume = FALSE;
+		displayPlayingScreen();
+	}
+	else if(gPlayerMode == PM_PLAYING && gRedrawSpectrum && !gVolumeOverlayTicks && gStatus.songTime == 0)
+	{
+		displaySpectrum();
+	}
+	gRedrawSpectrum = FALSE;
+
+	if(gRedrawDirEntries)
+	{
+		gRedrawDirEntries = FALSE;
+		displayDirEntries();
+	}
+
+	screenFlush();
+}
+
+// Answer a stats? request from the router with the worst-case execution time
+// (in us) and the number of missed deadlines of each task, in the order they
+// were added, and the bytes of stack headroom left:
+// "cmd:stats <wcet> <misses> <wcet> <misses> ... <stack>". This is too long
+// for a link frame, and sent without a sequence number; the router can
+// always ask again. The line has to fit in the transmit buffer, so the last
+// tasks are left out if it would not.
+void sendStats(void)
+{
+	char stringBuffer[SER_TX_LEN + STATS_PAIR_LEN];
+	char *end = stringBuffer;
+
+	strcpy_P(end, PSTR("cmd:stats"));
+	end += 9;
+	for(unsigned char i=0; i<schedNumTasks(); i++)
+	{
+		char *pair = end;
+
+		*end++ = ' ';
+		end = formatNumber(end, schedWorstCase(i));
+		*end++ = ' ';
+		end = formatNumber(end, schedMisses(i));
+		if(end - stringBuffer > SER_TX_LEN - 1 - STATS_TAIL_LEN)
+		{
+			end = pair;
+			break;
+		}
+	}
+	*end++ = ' ';
+	end = formatNumber(end, schedStackUnused());
+	*end++ = '\n';
+
+	putbytes(stringBuffer, end - stringBuffer);
+}
+
+// Main function. Apart from some initialization, this function starts the
+// tasks that handle messages received from the router over the serial line,
+// the buttons and the display
 int main(void)
 {
-	char artist[STR_LEN];	// Artist name
-	char title[STR_LEN];	// Title of current song
-	int playlistLength;		// Length of the playlist
-	int songNum;			// song number in the current playlist
-	int songTime;			// Total length of the song in seconds
-	int songElapsed;		// Elapsed time within the song in seconds
-	
-    ioinit();		// Setup IO pins and defaults
+    ledInit();		// Setup IO pins and defaults
+    buttonInit();
     inituart();		// initialize AVR serial port (USART0)
 
 	// Blink once to indicate succesful startup
@@ -298,283 +811,259 @@ int main(void)
 
     // Display splash screen
     lcd_clrscr();	
-    lcd_puts("    MPD Boombox\n   Jeroen Bouwens\n Sponsored by Sioux\n  Embedded Systems");
+    lcd_puts_P("    MPD Boombox\n   Jeroen Bouwens\n Sponsored by Sioux\n  Embedded Systems");
     _delay_ms(2000);
 	
-	// Initialize variables and the timer
-	gButtonPressSeen = 0;
+	// Initialize variables and the timers
 	gPlayerMode = PM_PLAYING;
-	init_timer1();
+	gStatus.volume = VOLUME_UNKNOWN;
+	schedInit();
 	sei();		// enable interrupts
-    
-    // Main program loop
-    for(;;) // Loop forever
-	{	
-		// Grab a line of data from the serial port
-		// Note: program execution will stall until serial data is received!
-		getline(serRXbuffer);		
-
-		// Blink once when a message was received
-		PORTC |= 0b0100000;
-		_delay_ms(100);
-		PORTC &= 0b1011111;
-			
-		// If I am playing, show track info
-		if(gPlayerMode == PM_PLAYING)
-		{
-			processPlayingLine(serRXbuffer, artist, title, &playlistLength, &songNum, &songTime, &songElapsed);
-				
-			lcd_clrscr();	// clear screen
 
-			displayTime(songElapsed, playlistLength, songNum);
-			displayProgressBar(songTime, songElapsed);
-			displayTrackInfo(title, artist);
-		}
-		// If I am browsing 
-		else
-		{
-			if(processResponse(serRXbuffer) == TRUE)
-			{
-				displayDirEntries();
-			}
-		}
-    }
+	// Tell the router we (re)started, so it forgets what it thinks the string
+	// cache holds and sends everything in full
+	sendHello();
+    
+	// Everything from here on runs as tasks
+	schedAddTask(serialTask, 1, 10);
+	schedAddTask(uiTask, 1000 / TICKS_PER_SECOND, 20);
+	schedAddTask(displayTask, 50, 50);
+	schedAddTask(linkTask, 10, 10);
+	schedRun();
 	 
     return 0;   // Never reached
 }
 
-void inituart(void)	// Initialize USART0 to desired baud rate
+// Merge a track information line into the player status. The elapsed time is
+// only taken over when the line carries one; otherwise the local clock keeps
+// running undisturbed. The line is parsed straight into gStatus, after saving
+// the few fields that may have to stay as they are.
+void updatePlayerStatus(const char *line)
 {
-	// Set baud rate generator based on F_CPU
-	UBRR0H = (unsigned char)(F_CPU/(16UL*BAUD)-1)>>8;
-	UBRR0L = (unsigned char)(F_CPU/(16UL*BAUD)-1);
-	
-	// Enable USART0 transmitter and receiver
-	UCSR0B = (1<<RXEN0) | (1<<TXEN0);
+	int songNum = gStatus.songNum;
+	int songTime = gStatus.songTime;
+	int songElapsed = gStatus.songElapsed;
+	int volume = gStatus.volume;
+	unsigned int found;
 
-}
+	found = processPlayingLine(line, &gStatus);
+	if(!found)
+	{
+		return;
+	}
 
-unsigned char uart_getchar(void)
-{
-	while(!(UCSR0A & (1 << RXC0)))	// wait until character is received
-		;	// do nothing
-	
-	return UDR0;
-}
+	// The router and the string cache are out of step, e.g. because a line
+	// was lost. Ask for a fresh start; the strings come in full next time.
+	if(found & FOUND_BAD_REF)
+	{
+		sendHello();
+	}
 
-void uart_putchar(unsigned char data)	// send a character over the serial port
-{
+	if(found & FOUND_TIME)
+	{
+		gClockTicks = 0;	// Count the next second from the moment of the resync
+	}
+	else
+	{
+		gStatus.songElapsed = songElapsed;
+	}
 
-	while(!(UCSR0A & (1 << UDRE0))) // wait until UART is ready for tx
-		;       // do nothing
-	UDR0 = data;    // send char
+	// While the volume bar is up, the local volume is ahead of the router
+	if(gVolumeOverlayTicks)
+	{
+		gStatus.volume = volume;
+	}
 
+	// After next/prev the local song is ahead of the router until the router
+	// reports that it is playing the song we jumped to. Its title is not
+	// known until then (see selectSong()).
+	if(gJumpSettleTicks || (gJumpHoldTicks && gStatus.songNum != songNum))
+	{
+		gStatus.songNum = songNum;
+		gStatus.songElapsed = songElapsed;
+		gStatus.songTime = songTime;
+		gStatus.artist[0] = '\0';
+		gStatus.title[0] = '\0';
+	}
+	else if(found & FOUND_SONG)
+	{
+		gJumpHoldTicks = 0;
+	}
+
+	updateTopics();
+	gRedrawPlaying = TRUE;
 }
 
-void uart_flush(void)	// flush RX buffer
+// Compose the complete playing screen from the current player status
+void displayPlayingScreen(void)
 {
-	unsigned char dummy;
-	
-	while(UCSR0A & (1<<RXC0))	// while there is a character in the RX queue
-		dummy = UDR0;			// flush the queue by reading it
+	displayTime(&gStatus);
+	if(gVolumeOverlayTicks)
+	{
+		displayVolume(gStatus.volume);
+	}
+	else if(gStatus.songTime == 0 && gSpectrumFresh)
+	{
+		displaySpectrum();
+	}
+	else
+	{
+		displayProgressBar(gStatus.songTime, gStatus.songElapsed);
+	}
+
+	// The page may have become empty since it was selected
+	displayPage(pageAvailable(gPage, &gStatus) ? gPage : PAGE_NOW_PLAYING, &gStatus);
 }
 
-void getline(char *buffer)	// get a single line from the UART rcvr
+// Check whether a page of the playing screen has anything to show
+BOOL pageAvailable(unsigned char page, const PlayerStatus *status)
 {
-	int bufpos = 0;
-	
-	uart_flush();	// clear RX buffer of stale chars if present
-	
-	// read a line from UART, stop if buffer is full or we reach newline
-	while ((bufpos < (SER_BUFF_LEN - 1)) && (buffer[bufpos] = uart_getchar()) != '\n') {
-
-		if (buffer[bufpos] == '\r')
-			bufpos--;	// strip carriage returns in case data contains both CR&LF
-			
-		bufpos++;
+	switch(page)
+	{
+		case PAGE_NEXT_UP:	return status->nextArtist[0] || status->nextTitle[0];
+		case PAGE_FORMAT:	return status->audio[0] || status->bitrate;
+		case PAGE_QUEUE:	return status->playlistLength > 0;
+		case PAGE_CLOCK:	return status->state != STATE_STOP;
+		default:			return TRUE;
 	}
-	
-	buffer[bufpos] = '\0';	// turn buffer into a string
 }
 
-void ioinit (void)
+// Compose one of the pages in the middle two lines of the playing screen
+void displayPage(unsigned char page, const PlayerStatus *status)
 {
-    //1 = output, 0 = input
-    DDRC  |= 0b0100000; // PC5 is output
-	
-	DDRB  &= 0b11111000; // PB0, 1, 2 are input
-	PORTB |= 0b00000111; // Enable internal pull-up resistors	
+	screenClearLine(1);
+	screenClearLine(2);
 
-	DDRD  &= 0b00011111; // PB5, 6, 7 are input
-	PORTD |= 0b11100000; // Enable internal pull-up resistors
+	switch(page)
+	{
+		case PAGE_NEXT_UP:	displayNextUp(status);	break;
+		case PAGE_FORMAT:	displayFormat(status);	break;
+		case PAGE_QUEUE:	displayQueue(status);	break;
+		case PAGE_CLOCK:	displayBigTime(status->songElapsed);	break;
+		default:			displayTrackInfo(status->title, status->artist);	break;
+	}
 }
 
-void putstring(char *buffer)	// send a string to the UART
+// Display the volume as a bar with a percentage, in place of the progress bar
+void displayVolume(int volume)
 {
-	int bufpos = 0;
-	
-	cli();	// disable interrupts so we don't mangle the data
-	
-	// start sending characters over the serial port until we reach the end of the string
-	while ((bufpos < (SER_BUFF_LEN - 1)) && (buffer[bufpos] != '\0')) 
+	char line[LCD_WIDTH + 1];
+	char number[FORMAT_NUMBER_LEN];
+	char *end = formatNumber(number, volume);
+	char *pos = line;
+
+	screenClearLine(3);
+
+	*pos++ = 'V';
+	*pos++ = 'o';
+	*pos++ = 'l';
+	*pos++ = ' ';
+	pos = renderBar(pos, LCD_WIDTH - 9, volume, 100, 3);	// "Vol " + bar + " 100%"
+
+	// Right-align the percentage
+	for(int i=end - number; i<4; i++)
 	{
-		uart_putchar(buffer[bufpos]);
-			
-		bufpos++;
+		*pos++ = ' ';
 	}
-	
-	sei();	// enable interrupts again
-	
+	memcpy(pos, number, end - number);
+	pos += end - number;
+	*pos++ = '%';
+	*pos = '\0';
+
+	screenPuts(0, 3, line);
 }
 
-void init_timer1(void) 
+// Display the track name and artist, or the stream name and track name
+void displayTrackInfo(const char *trackName, const char *artistName)
 {
-	// initialize TIMER1 to trigger an overflow interrupt every 0.5sec
-	TCCR1A = 0;
-	TCCR1B |= (1 << CS12) | (1 << CS10);
+	char text[STR_LEN];
 
-	
-	TCNT1 = 0x10000 - (F_CPU/1024/4);
-	
-	TIFR1=0;
-	TIMSK1 |= (1 << TOIE1);
+	glyphText(text, artistName, 1);
+	screenCenter(1, text);
+
+	glyphText(text, trackName, 2);
+	screenCenter(2, text);
+} 
+
+// Display the artist and title of the next song in the playlist
+void displayNextUp(const PlayerStatus *status)
+{
+	char text[STR_LEN];
+
+	strcpy_P(text, PSTR("Next: "));
+	screenPuts(0, 1, text);
+	glyphText(text, status->nextArtist, 1);
+	screenPuts(6, 1, text);
+
+	glyphText(text, status->nextTitle, 2);
+	screenCenter(2, text);
 }
 
-// Process a message in the response format
-BOOL processResponse(char *RXserbuffer)
+// Display the sample format and bitrate of what is playing
+void displayFormat(const PlayerStatus *status)
 {
-	// The following code assumes the message has the following format:
-	//		resp: param1,param2,param3,param4
-	// It wil store the params in the gDirEntries array. Less than 4 params
-	// will also work
-	// NOTE: All params, including the last one, must be followed by a comma
+	char text[STR_LEN];
+
+	screenCenter(1, status->audio);
 
-	// Check if this is a response message
-	char *responsePtr = strstr(RXserbuffer, "resp: ");
-	if(responsePtr)
+	if(status->bitrate)
 	{
-		gNumDirEntries = 0;
-		char *respStart = responsePtr + sizeof("resp: ") - 1; // Skip the indentifier part
-		char *commaPtr = strstr(respStart, ","); 			   // Find the comma separating param1 and param2
-		
-		// Assume there are 4 parameters. If less than 4 are found, fill in blanks
-		for(int i=0; i<4; i++)
-		{
-			if(commaPtr)
-			{
-				int strLen = commaPtr - respStart; 
-				strncpy(gDirEntries[i], respStart , strLen);
-				gDirEntries[i][strLen] = '\0';		// Make the string zero-terminated
-				respStart = commaPtr+1;
-				commaPtr = strstr(respStart, ",");
-				gNumDirEntries++; 					// Some administration
-			}
-			else
-			{
-				gDirEntries[i][0] = '\0';	
-			}
-		}		
-		gWaitingForReply = FALSE;
-		return TRUE;
+		char *end = formatNumber(text, status->bitrate);
+		strcpy_P(end, PSTR(" kbps"));
+		screenCenter(2, text);
 	}
-	
-	return FALSE;
 }
 
-// Process a message in the track information format
-void processPlayingLine(char *RXserbuffer, char *artist, char *title, 
-						int *playlistLength, int *songNum, int *songTime, int *songElapsed)
+// Display the length of the playlist, how much of it is left and its total duration
+void displayQueue(const PlayerStatus *status)
 {
-	// The following code assumes the message has one of the following two formats:
-	//
-	// 	Artis: <artist> Title: <title> playlistlength: <playlistlength> song: <song> time: <time>
-	//
-	//  Title: <title> Name: <name> playlistlength: <playlistlength> song: <song> time: <time>
-	//
-	// Time is in the format <elapsedSeconds>:<totalDurationSeconds>
-	// The order of the fields DOES MATTER! 
-
-	char *artistPtr 	= strstr(RXserbuffer, "Artist: ");
-	char *titlePtr 		= strstr(RXserbuffer, "Title: ");
-	char *namePtr		= strstr(RXserbuffer, "Name: ");
-	char *plLengthPtr	= strstr(RXserbuffer, "playlistlength: ");
-	char *songPtr 		= strstr(RXserbuffer, "song: ");
-	char *timePtr 		= strstr(RXserbuffer, "time: ");
+	char text[32];		// Longest: "32000 to go, 32000 min"
+	char *end;
+	int toGo = status->playlistLength - status->songNum;
 
-	int stringLength = 0;	
+	end = formatNumber(strcpy_P(text, PSTR("Queue: ")) + 7, status->playlistLength);
+	strcpy_P(end, PSTR(" tracks"));
+	screenCenter(1, text);
 
-	if(artistPtr && titlePtr)
-	{
-		char *artistStart = artistPtr + sizeof("Artist: ") - 1;
-		stringLength = titlePtr - (artistPtr + sizeof("Artist: ") - 1);
-		stringLength = stringLength > 20 ? 20 : stringLength;
-		strncpy(artist, artistStart , stringLength);
-	}
-	artist[stringLength] = '\0';
-	
-	stringLength = 0;
-	if(titlePtr && namePtr) // If we're playing a stream the "artist" field will not be present and there will be a "name" field between title and playlistlength
+	end = formatNumber(text, toGo > 0 ? toGo : 0);
+	end = strcpy_P(end, PSTR(" to go")) + 6;
+	if(status->queueMinutes)
 	{
-		char *titleStart = titlePtr + sizeof("Title: ") - 1;			// Skip the field name
-		stringLength = namePtr - (titlePtr + sizeof("Title: ") - 1);	// Determine the length of the field value
-		stringLength = stringLength > 20 ? 20 : stringLength; 			// Truncate to the maximum width of the display
-		strncpy(title, titleStart, stringLength);						// Copy the field value to the appropriate buffer
+		end = formatNumber(strcpy_P(end, PSTR(", ")) + 2, status->queueMinutes);
+		strcpy_P(end, PSTR(" min"));
 	}
-	else if(titlePtr && plLengthPtr) // There's no "name" field, so we're playing an MP3 and there will be a playlistlength field after the title
-	{
-		char *titleStart = titlePtr + sizeof("Title: ") - 1;
-		stringLength = plLengthPtr - (titlePtr + sizeof("Title: ") - 1);
-		stringLength = stringLength > 20 ? 20 : stringLength;
-		strncpy(title, titleStart, stringLength);
-		
-	}
-	title[stringLength] = '\0';
-	
-	if(namePtr && plLengthPtr)
-	{
-		char *nameStart = namePtr + sizeof("Name: ") - 1;
-		stringLength = plLengthPtr - (namePtr + sizeof("Name: ") - 1);
-		stringLength = stringLength > 20 ? 20 : stringLength;
-		strncpy(artist, nameStart , stringLength);
-		artist[stringLength] = '\0';
-	}
-	
-	if(plLengthPtr && songPtr)
-	{
-		char *pllStart = plLengthPtr + sizeof("playlistlength: ") - 1;
-		stringLength = songPtr - (plLengthPtr + sizeof("playlistlength: ") - 1);
-		pllStart[stringLength] = '\0';
-		*playlistLength = atoi(pllStart);
-	}
-	
-	if(songPtr && timePtr)
-	{
-		char *songStart = songPtr + sizeof("song: ") - 1;
-		stringLength = timePtr - (songPtr + sizeof("song: ") - 1);
-		songStart[stringLength] = '\0';
-		*songNum = atoi(songStart) + 1;
-	}
-	
-	if(timePtr)
-	{
-		char *timeStart = timePtr + sizeof("time: ") - 1;
-		char *songTotalTime = strstr(timeStart, ":") + 1;
-		*(songTotalTime-1) = '\0'; // Insert a terminating \0 to separate the elapsed time from the total time
-		*songElapsed = atoi(timeStart);
-		*songTime = atoi(songTotalTime);
-	}	
+	screenCenter(2, text);
 }
 
-// Display the track name and artist, or the stream name and track name
-void displayTrackInfo(char *trackName, char *artistName)
+// Render a bar of the given number of cells, filled in proportion to
+// value / maxValue with a resolution of one pixel column, into dest. The glyphs
+// used are pinned to the given display line. Returns the end of the bar.
+char *renderBar(char *dest, unsigned char cells, long value, long maxValue, unsigned char line)
 {
+	long columns = (value * cells * GLYPH_BAR_STEPS) / maxValue;
+
+	if(columns < 0)
+	{
+		columns = 0;
+	}
 
-	lcd_gotoxy(10-strlen(artistName)/2,1);
-	lcd_puts(artistName);
+	for(unsigned char i=0; i<cells; i++)
+	{
+		if(columns >= GLYPH_BAR_STEPS)
+		{
+			*dest++ = GLYPH_FULL_BLOCK;
+			columns -= GLYPH_BAR_STEPS;
+		}
+		else
+		{
+			*dest++ = glyphGet(GLYPH_BAR_0 + columns, line);
+			columns = 0;
+		}
+	}
+	*dest = '\0';
 
-	lcd_gotoxy(10-strlen(trackName)/2,2);
-	lcd_puts(trackName);
-} 
+	return dest;
+}
 
 // Display the progress bar that indicates the percentage of a track that has 
 // elapsed. Note that this will have no function when playing a stream, since
@@ -582,62 +1071,145 @@ void displayTrackInfo(char *trackName, char *artistName)
 // stream
 void displayProgressBar(int songLength, int songElapsed)
 {
+	char line[LCD_WIDTH + 1];
+
+	screenClearLine(3);
+
 	if(songLength > 0)
 	{
-		// Elapsed part
-		for(int i=0; i<((songElapsed*100)/songLength)/5; i++)
+		renderBar(line, LCD_WIDTH, songElapsed, songLength, 3);
+	}
+	else
+	{
+		// Playing a stream, leave the line empty
+		return;
+	}
+
+	screenPuts(0, 3, line);
+}
+
+// Display the spectrum of what is playing as vertical bars, in place of the
+// progress bar a stream does not have
+void displaySpectrum(void)
+{
+	char line[LCD_WIDTH + 1];
+
+	screenClearLine(3);
+
+	for(unsigned char i=0; i<SPECTRUM_BARS; i++)
+	{
+		unsigned char height = gSpectrum[i];
+
+		if(height == 0)
 		{
-			lcd_gotoxy(i, 3);
-			lcd_putc('#');
+			line[i] = ' ';
 		}
-		
-		// Still remaining part
-		for(int i=((songElapsed*100)/songLength)/5; i<20; i++)
+		else if(height == SPECTRUM_LEVELS - 1)
+		{
+			line[i] = GLYPH_FULL_BLOCK;
+		}
+		else
 		{
-			lcd_gotoxy(i, 3);
-			lcd_putc('-');
+			line[i] = glyphGet(GLYPH_VBAR_1 + height - 1, 3);
 		}
 	}
+	line[SPECTRUM_BARS] = '\0';
+
+	screenPuts(0, 3, line);
+}
+
+// Display the state of the player, the track elapsed time, and the playlist
+// info (position in playlist + playlist length)
+void displayTime(const PlayerStatus *status)
+{
+	char line[LCD_WIDTH + 1];
+	char position[20];
+	char *pos = line;
+	unsigned char glyph;
+
+	screenClearLine(0);
+
+	if(status->state == STATE_PLAY)
+	{
+		glyph = status->songTime ? GLYPH_PLAY : GLYPH_STREAM;
+	}
+	else if(status->state == STATE_PAUSE)
+	{
+		glyph = GLYPH_PAUSE;
+	}
 	else
 	{
-		// Playing a stream, fill with '-'s
-		for(int i=0; i<20; i++)
-		{
-			lcd_gotoxy(i, 3);
-			lcd_putc(' ');
-		}		
+		glyph = GLYPH_STOP;
+	}
+	*pos++ = glyphGet(glyph, 0);
+	*pos++ = ' ';
+	pos = formatTime(pos, status->songElapsed);
+
+	// Position right aligned, the line is written as a whole so no stale
+	// characters remain when the time or position gets shorter
+	char *end = formatPosition(position, status->songNum, status->playlistLength);
+	if(end - position > line + LCD_WIDTH - pos)
+	{
+		end = position + (line + LCD_WIDTH - pos);
+		*end = '\0';
+	}
+	while(pos < line + LCD_WIDTH - (end - position))
+	{
+		*pos++ = ' ';
 	}
+	strcpy(pos, position);
+
+	screenPuts(0, 0, line);
 }
 
-// Display the track elapsed time, and the playlist info (position in playlist + playlist length)
-void displayTime(int songElapsed, int playlistLength, int songNum)
+// Display the elapsed time in big digits, on the lines of the track info
+void displayBigTime(int songElapsed)
 {
-	char stringBuffer[20];
- 
-	sprintf(stringBuffer, "%d:%02d", songElapsed / 60, songElapsed % 60);
-	lcd_gotoxy(0, 0);
-	lcd_puts(stringBuffer);
+	char time[8];
+	char upper[LCD_WIDTH + 1];
+	char lower[LCD_WIDTH + 1];
+
+	// "99:59" is the widest time that fits the display in big digits
+	if(songElapsed > 99 * 60 + 59)
+	{
+		songElapsed = 99 * 60 + 59;
+	}
+
+	formatTime(time, songElapsed);
+	glyphBigText(upper, lower, time, 1);
 
-	sprintf(stringBuffer, "(%d of %d)", songNum, playlistLength);
-	lcd_gotoxy(20-strlen(stringBuffer), 0);
-	lcd_puts(stringBuffer);
+	screenCenter(1, upper);
+	screenCenter(2, lower);
 }
 
 // Display the (at most) 4 directory entries received from the router, and indicate which
 // is the currently selected one.
 void displayDirEntries()
 {
-	lcd_clrscr();
+	screenClear();
 			
 	for(int y=0; y<4; y++)
 	{
-		lcd_gotoxy(1, y);
-		lcd_puts(gDirEntries[y]);
+		char text[STR_LEN];
+
+		glyphText(text, gDirEntries[y], y);
+		screenPuts(1, y, text);
 		
 		if(y == gCurrentListSelectedIndex)
 		{
-			lcd_gotoxy(0, y);
-			lcd_puts(">");
+			screenPuts(0, y, ">");
 		}
 	}
+
+	// Scroll arrows in the right column, when there is more above or below
+	if(gCurrentListStartIndex > 0)
+	{
+		char arrow[2] = { glyphGet(GLYPH_ARROW_UP, 0), '\0' };
+		screenPuts(LCD_WIDTH - 1, 0, arrow);
+	}
+	if(gNumDirEntries == MAX_DIR_ENTRIES)
+	{
+		char arrow[2] = { glyphGet(GLYPH_ARROW_DOWN, MAX_DIR_ENTRIES - 1), '\0' };
+		screenPuts(LCD_WIDTH - 1, MAX_DIR_ENTRIES - 1, arrow);
+	}
 }
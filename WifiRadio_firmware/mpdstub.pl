@@ -0,0 +1,611 @@
+#!/usr/bin/perl -w
+
+# Stand-in for MPD, for running interface.pl (and mpc) without a router, a
+# music share or a real MPD. It speaks enough of the MPD protocol for
+# everything the radio uses, over a synthetic library of configurable size:
+#
+#   Artist 00001/Album 01/01 - Track 01.mp3
+#
+# The library is computed from the track index, so even a million entries
+# take no memory. Responses can be delayed to mimic a slow router or share,
+# and adding files to the queue can be made to cost time per file.
+#
+# Usage: mpdstub.pl [--port 6600] [--tracks 10000] [--latency ms] [--jitter ms] [--addcost ms]
+#
+# Per-command counts, wall time and CPU time are printed on SIGUSR1 and on exit.
+
+use strict;
+use IO::Socket::INET;
+use IO::Select;
+use Getopt::Long;
+use Time::HiRes qw(time);
+
+my $port = 6600;
+my $numTracks = 10000;
+my $latency = 0;            # fixed delay added to every response, in ms
+my $jitter = 0;             # random extra delay on top of that, in ms
+my $addCost = 0;            # time it takes to add one file to the queue, in ms
+my $tracksPerAlbum = 12;
+my $albumsPerArtist = 8;
+
+GetOptions("port=i" => \$port, "tracks=i" => \$numTracks, "latency=i" => \$latency,
+           "jitter=i" => \$jitter, "addcost=f" => \$addCost, "albumtracks=i" => \$tracksPerAlbum,
+           "artistalbums=i" => \$albumsPerArtist) or die "Invalid options\n";
+
+my $tracksPerArtist = $tracksPerAlbum * $albumsPerArtist;
+my $numArtists = int(($numTracks + $tracksPerArtist - 1) / $tracksPerArtist);
+
+#=========== Synthetic library ===========
+
+sub artistName($) { return sprintf("Artist %05d", $_[0] + 1); }
+sub albumName($)  { return sprintf("Album %02d", $_[0] + 1); }
+
+# Path of the track with the given index
+sub trackPath($)
+{
+    my $t = shift;
+    my $artist = int($t / $tracksPerArtist);
+    my $album = int(($t % $tracksPerArtist) / $tracksPerAlbum);
+    my $track = $t % $tracksPerAlbum;
+    return sprintf("%s/%s/%02d - Track %02d.mp3", artistName($artist), albumName($album), $track + 1, $track + 1);
+}
+
+sub trackDuration($) { return 120 + ($_[0] * 37) % 300; }
+
+# Resolve a directory or file uri to the range [first, last) of track indices
+# it contains. Returns an empty list if the uri does not exist.
+sub resolve($)
+{
+    my $uri = shift;
+    $uri =~ s/\/+$//;
+
+    return (0, $numTracks) if $uri eq "";
+
+    if($uri =~ m/^Artist (\d+)(?:\/Album (\d+)(?:\/(\d+) - Track \d+\.mp3)?)?$/)
+    {
+        my ($artist, $album, $track) = ($1 - 1, defined $2 ? $2 - 1 : undef, defined $3 ? $3 - 1 : undef);
+        return () if $artist < 0 || $artist >= $numArtists;
+        my $first = $artist * $tracksPerArtist;
+        my $last = $first + $tracksPerArtist;
+        if(defined $album)
+        {
+            return () if $album < 0 || $album >= $albumsPerArtist;
+            $first += $album * $tracksPerAlbum;
+            $last = $first + $tracksPerAlbum;
+        }
+        if(defined $track)
+        {
+            return () if $track < 0 || $track >= $tracksPerAlbum;
+            $first += $track;
+            $last = $first + 1;
+        }
+        $last = $numTracks if $last > $numTracks;
+        return () if $first >= $last;
+        return ($first, $last);
+    }
+
+    return ();
+}
+
+sub fileInfo($)
+{
+    my $t = shift;
+    my $track = $t % $tracksPerAlbum;
+    return "file: ".trackPath($t)."\n".
+           "Time: ".trackDuration($t)."\n".
+           "Artist: ".artistName(int($t / $tracksPerArtist))."\n".
+           "Album: ".albumName(int(($t % $tracksPerArtist) / $tracksPerAlbum))."\n".
+           sprintf("Title: Track %02d\n", $track + 1).
+           "Track: ".($track + 1)."\n";
+}
+
+#=========== Player state ===========
+
+my @queue = ();             # track indices, or stream urls
+my $state = "stop";
+my $song = 0;
+my $elapsed = 0;            # elapsed time at $startedAt
+my $startedAt = 0;
+my $volume = 50;
+my $repeat = 0;
+my $random = 0;
+my $playlistVersion = 1;
+my $nextId = 1;
+my @queueIds = ();
+
+my %idleEvents = ();        # per client: subsystems changed since the client last went idle
+
+sub changed(@)
+{
+    foreach my $client (keys %idleEvents)
+    {
+        $idleEvents{$client}{$_} = 1 foreach @_;
+    }
+}
+
+sub isStream($) { return $_[0] =~ m/^[a-z]+:\/\//; }
+
+sub currentElapsed()
+{
+    return $state eq "play" ? $elapsed + (time() - $startedAt) : $elapsed;
+}
+
+sub startPlaying($)
+{
+    my $pos = shift;
+    return 0 if $pos < 0 || $pos > $#queue;
+    $song = $pos;
+    $elapsed = 0;
+    $startedAt = time();
+    $state = "play";
+    changed("player");
+    return 1;
+}
+
+sub stopPlaying()
+{
+    $state = "stop";
+    $elapsed = 0;
+    changed("player");
+}
+
+# Advance to the next track when the current one has finished
+sub advance()
+{
+    return if $state ne "play" || $song > $#queue;
+    my $item = $queue[$song];
+    return if isStream($item);
+    return if currentElapsed() < trackDuration($item);
+
+    if($song < $#queue)         { startPlaying($song + 1); }
+    elsif($repeat && @queue)    { startPlaying(0); }
+    else                        { stopPlaying(); }
+}
+
+sub addToQueue(@)
+{
+    select(undef, undef, undef, @_ * $addCost / 1000) if $addCost;    # MPD reads the tags of every file it adds
+    foreach(@_)
+    {
+        push(@queue, $_);
+        push(@queueIds, $nextId++);
+    }
+    $playlistVersion++;
+    changed("playlist");
+}
+
+sub queueEntry($)
+{
+    my $pos = shift;
+    my $item = $queue[$pos];
+    my $info = isStream($item) ? "file: $item\nName: Stream ".($pos + 1)."\nTitle: Live\n" : fileInfo($item);
+    return $info."Pos: $pos\nId: $queueIds[$pos]\n";
+}
+
+# Parse "N" or "START:END" into a position range within the queue
+sub queueRange($)
+{
+    my $arg = shift;
+    return (0, scalar(@queue)) if !defined $arg;
+    return ($1, $2 ne "" ? $2 : scalar(@queue)) if $arg =~ m/^(\d+):(\d*)$/;
+    return ($arg, $arg + 1) if $arg =~ m/^\d+$/;
+    return ();
+}
+
+#=========== Commands ===========
+
+# Each handler gets the arguments and returns the response body, or dies
+# with an "ACK" message.
+my %commands;
+%commands = (
+    ping => sub { return ""; },
+
+    status => sub {
+        advance();
+        my $s = "volume: $volume\nrepeat: $repeat\nrandom: $random\nsingle: 0\nconsume: 0\n".
+                "playlist: $playlistVersion\nplaylistlength: ".scalar(@queue)."\nstate: $state\n";
+        if($state ne "stop" && $song <= $#queue)
+        {
+            my $item = $queue[$song];
+            my $total = isStream($item) ? 0 : trackDuration($item);
+            $s .= "song: $song\nsongid: $queueIds[$song]\n";
+            if($song < $#queue || $repeat)
+            {
+                my $next = ($song + 1) % @queue;
+                $s .= "nextsong: $next\nnextsongid: $queueIds[$next]\n";
+            }
+            $s .= "time: ".int(currentElapsed()).":$total\n";
+            $s .= sprintf("elapsed: %.3f\n", currentElapsed());
+            $s .= "bitrate: ".(isStream($item) ? 128 : 192)."\naudio: 44100:24:2\n";
+        }
+        return $s;
+    },
+
+    currentsong => sub {
+        advance();
+        return "" if $state eq "stop" || $song > $#queue;
+        return queueEntry($song);
+    },
+
+    stats => sub {
+        return "artists: $numArtists\nalbums: ".int(($numTracks + $tracksPerAlbum - 1) / $tracksPerAlbum).
+               "\nsongs: $numTracks\nuptime: 1\nplaytime: 0\ndb_playtime: 0\ndb_update: 0\n";
+    },
+
+    lsinfo => sub {
+        my $uri = defined $_[0] ? $_[0] : "";
+        $uri =~ s/\/+$//;
+        my $s = "";
+
+        if($uri eq "")
+        {
+            $s .= "directory: ".artistName($_)."\n" for (0 .. $numArtists - 1);
+            return $s;
+        }
+
+        my @range = resolve($uri) or die "ACK [50\@0] {lsinfo} No such directory\n";
+        if($uri =~ m/\.mp3$/)
+        {
+            return fileInfo($range[0]);
+        }
+        elsif($uri =~ m/\//)
+        {
+            $s .= fileInfo($_) for ($range[0] .. $range[1] - 1);
+        }
+        else
+        {
+            my $albums = int(($range[1] - $range[0] + $tracksPerAlbum - 1) / $tracksPerAlbum);
+            $s .= "directory: $uri/".albumName($_)."\n" for (0 .. $albums - 1);
+        }
+        return $s;
+    },
+
+    listall => sub {
+        my @range = resolve(defined $_[0] ? $_[0] : "") or die "ACK [50\@0] {listall} No such directory\n";
+        my $s = "";
+        $s .= "file: ".trackPath($_)."\n" for ($range[0] .. $range[1] - 1);
+        return $s;
+    },
+
+    add => sub {
+        my $uri = defined $_[0] ? $_[0] : "";
+        if(isStream($uri))
+        {
+            addToQueue($uri);
+            return "";
+        }
+        my @range = resolve($uri) or die "ACK [50\@0] {add} Not found\n";
+        addToQueue($range[0] .. $range[1] - 1);
+        return "";
+    },
+
+    clear => sub {
+        @queue = ();
+        @queueIds = ();
+        $playlistVersion++;
+        stopPlaying();
+        changed("playlist");
+        return "";
+    },
+
+    delete => sub {
+        my ($start, $end) = queueRange($_[0]);
+        die "ACK [2\@0] {delete} Bad song index\n" if !defined $start || $start > $#queue || $end <= $start;
+        $end = scalar(@queue) if $end > @queue;
+        splice(@queue, $start, $end - $start);
+        splice(@queueIds, $start, $end - $start);
+        if($song >= $end)           { $song -= $end - $start; }
+        elsif($song >= $start)      { stopPlaying(); $song = $start; }
+        $playlistVersion++;
+        changed("playlist");
+        return "";
+    },
+
+    playlistinfo => sub {
+        my ($start, $end) = queueRange($_[0]);
+        die "ACK [2\@0] {playlistinfo} Bad song index\n" if !defined $start;
+        $end = scalar(@queue) if $end > @queue;
+        my $s = "";
+        $s .= queueEntry($_) for ($start .. $end - 1);
+        return $s;
+    },
+
+    # Deprecated, but still used by older mpc versions
+    playlist => sub {
+        my $s = "";
+        for(my $i=0; $i<@queue; $i++)
+        {
+            $s .= "$i:".(isStream($queue[$i]) ? $queue[$i] : trackPath($queue[$i]))."\n";
+        }
+        return $s;
+    },
+
+    play => sub {
+        my $pos = defined $_[0] ? $_[0] : ($state eq "stop" ? 0 : $song);
+        if($state eq "pause" && !defined $_[0])
+        {
+            $startedAt = time();
+            $state = "play";
+            changed("player");
+            return "";
+        }
+        startPlaying($pos) or die "ACK [2\@0] {play} Bad song index\n";
+        return "";
+    },
+
+    playid => sub {
+        my $id = defined $_[0] ? $_[0] : $queueIds[$song];
+        for(my $i=0; $i<@queueIds; $i++)
+        {
+            return $commands{play}->($i) if $queueIds[$i] == $id;
+        }
+        die "ACK [50\@0] {playid} No such song\n";
+    },
+
+    pause => sub {
+        my $pause = defined $_[0] ? $_[0] : ($state eq "play" ? 1 : 0);
+        if($pause && $state eq "play")
+        {
+            $elapsed = currentElapsed();
+            $state = "pause";
+            changed("player");
+        }
+        elsif(!$pause && $state eq "pause")
+        {
+            $startedAt = time();
+            $state = "play";
+            changed("player");
+        }
+        return "";
+    },
+
+    stop => sub { stopPlaying(); return ""; },
+
+    next => sub {
+        return "" if $state eq "stop";
+        if($song < $#queue)         { startPlaying($song + 1); }
+        elsif($repeat && @queue)    { startPlaying(0); }
+        else                        { stopPlaying(); }
+        return "";
+    },
+
+    previous => sub {
+        return "" if $state eq "stop";
+        startPlaying($song > 0 ? $song - 1 : ($repeat ? $#queue : 0));
+        return "";
+    },
+
+    seek => sub {
+        my ($pos, $time) = @_;
+        startPlaying($pos) or die "ACK [2\@0] {seek} Bad song index\n";
+        $elapsed = $time || 0;
+        return "";
+    },
+
+    setvol => sub {
+        die "ACK [2\@0] {setvol} Invalid volume\n" if !defined $_[0] || $_[0] !~ m/^\d+$/ || $_[0] > 100;
+        $volume = $_[0];
+        changed("mixer");
+        return "";
+    },
+
+    volume => sub {
+        die "ACK [2\@0] {volume} Invalid volume\n" if !defined $_[0] || $_[0] !~ m/^[+-]?\d+$/;
+        $volume += $_[0];
+        $volume = 0 if $volume < 0;
+        $volume = 100 if $volume > 100;
+        changed("mixer");
+        return "";
+    },
+
+    repeat => sub { $repeat = $_[0] ? 1 : 0; changed("options"); return ""; },
+    random => sub { $random = $_[0] ? 1 : 0; changed("options"); return ""; },
+
+    outputs => sub { return "outputid: 0\noutputname: stub\noutputenabled: 1\n"; },
+);
+
+#=========== Statistics ===========
+
+my %stats = ();
+
+sub recordStats($$$)
+{
+    my ($command, $wall, $cpu) = @_;
+    $stats{$command}{count}++;
+    $stats{$command}{wall} += $wall;
+    $stats{$command}{cpu} += $cpu;
+}
+
+sub printStats()
+{
+    printf STDERR "%-14s %10s %12s %12s\n", "command", "count", "wall ms/cmd", "cpu ms/cmd";
+    foreach my $command (sort keys %stats)
+    {
+        my $s = $stats{$command};
+        printf STDERR "%-14s %10d %12.3f %12.3f\n", $command, $s->{count},
+               1000 * $s->{wall} / $s->{count}, 1000 * $s->{cpu} / $s->{count};
+    }
+}
+
+$SIG{USR1} = \&printStats;
+$SIG{INT} = $SIG{TERM} = sub { printStats(); exit(0); };
+$SIG{PIPE} = "IGNORE";      # a client that went away shows up as a failed write instead
+
+#=========== Protocol ===========
+
+# Split a command line into words, honouring MPD's double quoting
+sub splitArgs($)
+{
+    my $line = shift;
+    my @args = ();
+    while($line =~ m/\G\s*(?:"((?:[^"\\]|\\.)*)"|(\S+))/g)
+    {
+        my $arg = defined $1 ? $1 : $2;
+        $arg =~ s/\\(.)/$1/g if defined $1;
+        push(@args, $arg);
+    }
+    return @args;
+}
+
+# Execute one command and return its response, followed by $terminator; or
+# just the ACK line if it fails. $position is the position of the command in
+# a command list, which MPD reports in the ACK.
+sub execute($$$)
+{
+    my ($line, $terminator, $position) = @_;
+    my ($command, @args) = splitArgs($line);
+    return "ACK [5\@$position] {} No command given\n" if !defined $command;
+
+    my $handler = $commands{$command};
+    return "ACK [5\@$position] {$command} unknown command \"$command\"\n" if !$handler;
+
+    my $start = time();
+    my @cpuStart = times();
+    my $response = eval { $handler->(@args) };
+    my @cpuEnd = times();
+    recordStats($command, time() - $start, ($cpuEnd[0] + $cpuEnd[1]) - ($cpuStart[0] + $cpuStart[1]));
+
+    if($@)
+    {
+        (my $ack = $@) =~ s/^ACK \[(\d+)\@\d+\]/ACK [$1\@$position]/;
+        return $ack;
+    }
+    return $response.$terminator;
+}
+
+my $listener = IO::Socket::INET->new(LocalPort => $port, Listen => 16, ReuseAddr => 1)
+    or die "Cannot listen on port $port: $!\n";
+my $select = IO::Select->new($listener);
+my %clients = ();           # per connection: input buffer, command list state, pending output
+
+print STDERR "mpdstub: $numTracks tracks in $numArtists artists, listening on port $port\n";
+
+sub reply($$)
+{
+    my ($sock, $response) = @_;
+    my $delay = ($latency + ($jitter ? rand($jitter) : 0)) / 1000;
+    push(@{$clients{$sock}{out}}, [time() + $delay, $response]);
+}
+
+sub handleLine($$)
+{
+    my ($sock, $line) = @_;
+    my $c = $clients{$sock};
+
+    if(defined $c->{list})
+    {
+        if($line eq "command_list_end")
+        {
+            # Like MPD: the responses of all commands, separated by list_OK
+            # for command_list_ok_begin, and a single OK at the end. The first
+            # command that fails ends the list with its ACK instead.
+            my $response = "";
+            my $position = 0;
+            foreach my $queued (@{$c->{list}})
+            {
+                my $r = execute($queued, $c->{listOk} ? "list_OK\n" : "", $position++);
+                $response .= $r;
+                last if $r =~ m/^ACK/m;
+            }
+            $response .= "OK\n" if $response !~ m/^ACK/m;
+            undef $c->{list};
+            reply($sock, $response);
+        }
+        else
+        {
+            push(@{$c->{list}}, $line);
+        }
+        return;
+    }
+
+    if($line eq "command_list_begin" || $line eq "command_list_ok_begin")
+    {
+        $c->{list} = [];
+        $c->{listOk} = $line eq "command_list_ok_begin";
+    }
+    elsif($line =~ m/^idle\b/)
+    {
+        $c->{idle} = 1;
+    }
+    elsif($line eq "noidle")
+    {
+        if($c->{idle})
+        {
+            $c->{idle} = 0;
+            reply($sock, "OK\n");
+        }
+    }
+    elsif($line eq "close")
+    {
+        $c->{closing} = 1;
+    }
+    else
+    {
+        reply($sock, execute($line, "OK\n", 0));
+    }
+}
+
+while(1)
+{
+    # Wake up in time for delayed responses, track changes and idle clients
+    foreach my $sock ($select->can_read(0.05))
+    {
+        if($sock == $listener)
+        {
+            my $client = $listener->accept() or next;
+            $select->add($client);
+            $clients{$client} = { sock => $client, in => "", out => [] };
+            $idleEvents{$client} = {};
+            print $client "OK MPD 0.16.0\n";
+            next;
+        }
+
+        # On end of input, stop reading but still deliver any delayed responses
+        my $data;
+        if(!sysread($sock, $data, 65536))
+        {
+            $select->remove($sock);
+            $clients{$sock}{closing} = 1;
+            next;
+        }
+
+        $clients{$sock}{in} .= $data;
+        while($clients{$sock}{in} =~ s/^([^\n]*)\n//)
+        {
+            handleLine($sock, $1);
+        }
+    }
+
+    advance();
+
+    foreach my $c (values %clients)
+    {
+        my $sock = $c->{sock};
+
+        if($c->{idle} && %{$idleEvents{$sock}})
+        {
+            reply($sock, join("", map { "changed: $_\n" } sort keys %{$idleEvents{$sock}})."OK\n");
+            $idleEvents{$sock} = {};
+            $c->{idle} = 0;
+        }
+
+        while(@{$c->{out}} && $c->{out}[0][0] <= time())
+        {
+            my $item = shift(@{$c->{out}});
+            if(!print $sock $item->[1])
+            {
+                # The client closed its end; forget what it still had coming
+                $c->{out} = [];
+                $c->{closing} = 1;
+            }
+        }
+
+        if($c->{closing} && !@{$c->{out}})
+        {
+            $select->remove($sock);
+            delete $clients{$sock};
+            delete $idleEvents{$sock};
+            close($sock);
+        }
+    }
+}
@@ -0,0 +1,452 @@
+/*
+ * Parsers for the messages the router sends over the serial line.
+ *
+ * Everything received from the router is untrusted: lines may be truncated,
+ * garbled by noise or contain fields in an unexpected order. The parsers
+ * therefore never write into the receive buffer, never follow a pointer they
+ * did not check and never copy more than the destination can hold.
+ */
+
+//=========== Includes ===========
+
+#include <string.h>
+
+#include "parse.h"
+
+//=========== Defines ===========
+
+#define MAX_NUMBER		32000	// Largest value a parsed number is clamped to (int is 16 bits on the AVR)
+
+// Fields of a track information line, see processPlayingLine()
+#define FIELD_ARTIST	0
+#define FIELD_TITLE		1
+#define FIELD_NAME		2
+#define FIELD_PLLENGTH	3
+#define FIELD_SONG		4
+#define FIELD_TIME		5
+#define FIELD_STATE		6
+#define FIELD_VOLUME	7
+#define FIELD_NEXTARTIST	8
+#define FIELD_NEXTTITLE	9
+#define FIELD_AUDIO		10
+#define FIELD_BITRATE	11
+#define FIELD_QUEUEMINS	12
+#define NUM_FIELDS		13
+
+//=========== Local variables ===========
+
+static char strSlots[NUM_STR_SLOTS][STR_LEN];	// String cache, filled by the router
+
+// Field names are kept in flash. A field name is a word followed by ": ",
+// see processPlayingLine().
+static const char keyArtist[] PROGMEM	= "Artist";
+static const char keyTitle[] PROGMEM	= "Title";
+static const char keyName[] PROGMEM		= "Name";
+static const char keyPlLength[] PROGMEM	= "playlistlength";
+static const char keySong[] PROGMEM		= "song";
+static const char keyTime[] PROGMEM		= "time";
+static const char keyState[] PROGMEM	= "state";
+static const char keyVolume[] PROGMEM	= "volume";
+static const char keyNextArtist[] PROGMEM	= "nextartist";
+static const char keyNextTitle[] PROGMEM	= "nexttitle";
+static const char keyAudio[] PROGMEM	= "audio";
+static const char keyBitrate[] PROGMEM	= "bitrate";
+static const char keyQueueMins[] PROGMEM	= "queuemins";
+
+static PGM_P const fieldKeys[NUM_FIELDS] PROGMEM =
+{
+	keyArtist,
+	keyTitle,
+	keyName,
+	keyPlLength,
+	keySong,
+	keyTime,
+	keyState,
+	keyVolume,
+	keyNextArtist,
+	keyNextTitle,
+	keyAudio,
+	keyBitrate,
+	keyQueueMins
+};
+
+// The first character of each field name, in the same order, to find the
+// candidates for a word without following the pointers above
+static const char fieldInitials[NUM_FIELDS] PROGMEM = "ATNpstsvnnabq";
+
+//=========== Local functions ===========
+
+// Copy the characters in [start, end) to dest after its first len characters,
+// dropping trailing spaces and truncating to what fits in a buffer of STR_LEN
+// characters
+static void appendField(char *dest, int len, const char *start, const char *end)
+{
+	while(end > start && end[-1] == ' ')
+	{
+		end--;
+	}
+
+	while(start < end && len < STR_LEN - 1)
+	{
+		dest[len++] = *start++;
+	}
+	dest[len] = '\0';
+}
+
+// Copy the characters in [start, end) to dest, see appendField()
+static void copyField(char *dest, const char *start, const char *end)
+{
+	appendField(dest, 0, start, end);
+}
+
+// Check character of a string in the cache, see STR_CHECK_MASK
+static char stringCheck(const char *s)
+{
+	unsigned char sum = 0;
+
+	while(*s)
+	{
+		sum += *s++;
+	}
+
+	return '0' + (sum & STR_CHECK_MASK);
+}
+
+// Copy a string field to dest. The field either holds the string itself, or
+// refers to a slot of the string cache (STR_REF), or holds a string to store
+// in the cache as well (STR_STORE). Returns FALSE for a reference to an empty
+// or invalid slot, or one whose check character does not match the string in
+// the slot, in which case dest is left alone.
+static BOOL copyString(char *dest, const char *start, const char *end)
+{
+	if(end - start < 2 || (*start != STR_REF && *start != STR_STORE))
+	{
+		copyField(dest, start, end);
+		return TRUE;
+	}
+
+	unsigned char slot = start[1] - '0';
+	if(slot >= NUM_STR_SLOTS)
+	{
+		return FALSE;
+	}
+
+	if(*start == STR_STORE)
+	{
+		copyField(strSlots[slot], start + 2, end);
+	}
+	else if(!strSlots[slot][0] || end - start < 3 || start[2] != stringCheck(strSlots[slot]))
+	{
+		return FALSE;
+	}
+
+	// Most of the time the string did not change, and there is nothing to copy
+	if(strcmp(dest, strSlots[slot]))
+	{
+		strcpy(dest, strSlots[slot]);
+	}
+	return TRUE;
+}
+
+// Find the field whose name is the word of the given length. Returns
+// NUM_FIELDS if it is not a field name.
+static unsigned char findField(const char *word, int len)
+{
+	for(unsigned char i=0; i<NUM_FIELDS; i++)
+	{
+		if(pgm_read_byte(&fieldInitials[i]) != *word)
+		{
+			continue;
+		}
+
+		PGM_P key = (PGM_P)pgm_read_word(&fieldKeys[i]);
+
+		if(!strncmp_P(word, key, len) && !pgm_read_byte(key + len))
+		{
+			return i;
+		}
+	}
+
+	return NUM_FIELDS;
+}
+
+// Convert the decimal number at the start of [start, end) to an int. Parsing
+// stops at the first non-digit, and the result is clamped to MAX_NUMBER, so
+// arbitrarily long digit strings cannot overflow
+static int parseNumber(const char *start, const char *end)
+{
+	int value = 0;
+
+	while(start < end && *start >= '0' && *start <= '9')
+	{
+		if(value >= MAX_NUMBER / 10)
+		{
+			return MAX_NUMBER;
+		}
+		value = value * 10 + (*start - '0');
+		start++;
+	}
+
+	return value;
+}
+
+//=========== Public functions ===========
+
+// Process a message in the response format
+BOOL processResponse(const char *RXserbuffer, char entries[][STR_LEN], int *numEntries)
+{
+	// The following code assumes the message has the following format:
+	//		resp: param1,param2,param3,param4
+	// It wil store the params in the entries array. Less than 4 params
+	// will also work. Params longer than the display are truncated.
+	// NOTE: All params, including the last one, must be followed by a comma
+
+	// Check if this is a response message
+	const char *responsePtr = strstr_P(RXserbuffer, PSTR("resp: "));
+	if(!responsePtr)
+	{
+		return FALSE;
+	}
+
+	const char *respStart = responsePtr + sizeof("resp: ") - 1; // Skip the indentifier part
+	*numEntries = 0;
+
+	// Assume there are 4 parameters. If less than 4 are found, fill in blanks.
+	// A param that starts with STR_PREFIX only holds what follows the first
+	// <length> characters of the param before it.
+	for(int i=0; i<MAX_DIR_ENTRIES; i++)
+	{
+		const char *commaPtr = strchr(respStart, ',');	// Find the comma terminating this param
+		if(commaPtr)
+		{
+			int prefix = 0;
+
+			if(commaPtr - respStart >= 2 && *respStart == STR_PREFIX)
+			{
+				unsigned char length = respStart[1] - '0';
+
+				if(i > 0)
+				{
+					prefix = strlen(entries[i - 1]);
+					if(length < prefix)
+					{
+						prefix = length;
+					}
+					memcpy(entries[i], entries[i - 1], prefix);
+				}
+				respStart += 2;
+			}
+
+			appendField(entries[i], prefix, respStart, commaPtr);
+			respStart = commaPtr + 1;
+			(*numEntries)++; 					// Some administration
+		}
+		else
+		{
+			entries[i][0] = '\0';
+		}
+	}
+
+	return TRUE;
+}
+
+// Process a message in the track information format. Returns a combination of
+// the FOUND_ flags for the fields present in the line; 0 means this was not a
+// track information line at all.
+unsigned int processPlayingLine(const char *RXserbuffer, PlayerStatus *status)
+{
+	// The following code assumes the message has one of the following two formats:
+	//
+	// 	Artist: <artist> Title: <title> volume: <volume> playlistlength: <playlistlength> state: <state> song: <song> time: <time>
+	//
+	//  Title: <title> Name: <name> volume: <volume> playlistlength: <playlistlength> state: <state> song: <song> time: <time>
+	//
+	// Time is in the format <elapsedSeconds>:<totalDurationSeconds>, state is
+	// one of play, pause or stop.
+	// Information that changes less often comes in a separate line, in the format:
+	//
+	//  nextartist: <artist> nexttitle: <title> audio: <format> bitrate: <kbps> queuemins: <minutes>
+	//
+	// A field value runs until the next field name, so the order of the fields
+	// does not matter. Fields that are missing leave the old value untouched;
+	// the artist and title (or the next artist and title) are updated as a pair.
+	// These four can also come from the string cache, see copyString().
+
+	const char *valueStart[NUM_FIELDS];
+	const char *valueEnd[NUM_FIELDS];
+	unsigned int found = 0;
+	unsigned char lastField = NUM_FIELDS;
+	const char *word = RXserbuffer;
+	const char *p;
+
+	// The string fields are updated in pairs, and a missing one is empty
+	valueStart[FIELD_ARTIST] = valueEnd[FIELD_ARTIST] = NULL;
+	valueStart[FIELD_TITLE] = valueEnd[FIELD_TITLE] = NULL;
+	valueStart[FIELD_NEXTARTIST] = valueEnd[FIELD_NEXTARTIST] = NULL;
+	valueStart[FIELD_NEXTTITLE] = valueEnd[FIELD_NEXTTITLE] = NULL;
+
+	// A single pass over the line. A field name is the word in front of a
+	// ": ", and only its first occurrence counts. Each value ends where the
+	// next field name starts, or at the end of the line for the last field.
+	for(p = RXserbuffer; *p; p++)
+	{
+		if(*p == ' ')
+		{
+			word = p + 1;
+		}
+		else if(*p == ':' && p[1] == ' ')
+		{
+			unsigned char field = findField(word, p - word);
+
+			if(field != NUM_FIELDS && !(found & (1U << field)))
+			{
+				if(lastField != NUM_FIELDS)
+				{
+					valueEnd[lastField] = word;
+				}
+				found |= 1U << field;
+				lastField = field;
+				valueStart[field] = p + 2;
+			}
+		}
+	}
+
+	if(!found)
+	{
+		return 0;
+	}
+	valueEnd[lastField] = p;
+
+	// If we're playing a stream the "artist" field will not be present, and the
+	// stream name is shown in its place
+	if(found & FOUND_TRACK)
+	{
+		int artistField = (found & FOUND_NAME) ? FIELD_NAME : FIELD_ARTIST;
+
+		if(!copyString(status->artist, valueStart[artistField], valueEnd[artistField]))
+		{
+			found |= FOUND_BAD_REF;
+		}
+		if(!copyString(status->title, valueStart[FIELD_TITLE], valueEnd[FIELD_TITLE]))
+		{
+			found |= FOUND_BAD_REF;
+		}
+	}
+
+	if(found & FOUND_NEXT)
+	{
+		if(!copyString(status->nextArtist, valueStart[FIELD_NEXTARTIST], valueEnd[FIELD_NEXTARTIST]))
+		{
+			found |= FOUND_BAD_REF;
+		}
+		if(!copyString(status->nextTitle, valueStart[FIELD_NEXTTITLE], valueEnd[FIELD_NEXTTITLE]))
+		{
+			found |= FOUND_BAD_REF;
+		}
+	}
+
+	if(found & FOUND_AUDIO)
+	{
+		copyField(status->audio, valueStart[FIELD_AUDIO], valueEnd[FIELD_AUDIO]);
+	}
+
+	if(found & FOUND_BITRATE)
+	{
+		status->bitrate = parseNumber(valueStart[FIELD_BITRATE], valueEnd[FIELD_BITRATE]);
+	}
+
+	if(found & FOUND_QUEUEMINS)
+	{
+		status->queueMinutes = parseNumber(valueStart[FIELD_QUEUEMINS], valueEnd[FIELD_QUEUEMINS]);
+	}
+
+	if(found & FOUND_PLLENGTH)
+	{
+		status->playlistLength = parseNumber(valueStart[FIELD_PLLENGTH], valueEnd[FIELD_PLLENGTH]);
+	}
+
+	if(found & FOUND_SONG)
+	{
+		status->songNum = parseNumber(valueStart[FIELD_SONG], valueEnd[FIELD_SONG]) + 1;
+	}
+
+	if(found & FOUND_TIME)
+	{
+		const char *timeStart = valueStart[FIELD_TIME];
+		const char *timeEnd = valueEnd[FIELD_TIME];
+		const char *colonPtr = memchr(timeStart, ':', timeEnd - timeStart);
+
+		status->songElapsed = parseNumber(timeStart, timeEnd);
+		status->songTime = colonPtr ? parseNumber(colonPtr + 1, timeEnd) : 0;
+	}
+
+	if(found & FOUND_STATE)
+	{
+		const char *stateStart = valueStart[FIELD_STATE];
+		int stateLen = valueEnd[FIELD_STATE] - stateStart;
+
+		if(stateLen >= 4 && !memcmp_P(stateStart, PSTR("play"), 4))
+		{
+			status->state = STATE_PLAY;
+		}
+		else if(stateLen >= 5 && !memcmp_P(stateStart, PSTR("pause"), 5))
+		{
+			status->state = STATE_PAUSE;
+		}
+		else
+		{
+			status->state = STATE_STOP;
+		}
+	}
+
+	// MPD reports "volume: -1" when it has no mixer
+	if(found & FOUND_VOLUME)
+	{
+		if(valueStart[FIELD_VOLUME] < valueEnd[FIELD_VOLUME] && *valueStart[FIELD_VOLUME] == '-')
+		{
+			status->volume = VOLUME_UNKNOWN;
+		}
+		else
+		{
+			status->volume = parseNumber(valueStart[FIELD_VOLUME], valueEnd[FIELD_VOLUME]);
+		}
+	}
+
+	return found;
+}
+
+// Process a spectrum line into SPECTRUM_BARS bar heights. The heights are
+// only written when the complete line is valid.
+BOOL processSpectrumLine(const char *RXserbuffer, unsigned char *heights)
+{
+	if(strncmp_P(RXserbuffer, PSTR("spec: "), 6))
+	{
+		return FALSE;
+	}
+
+	const char *packed = RXserbuffer + 6;
+
+	for(int i=0; i<SPECTRUM_BARS / 2; i++)
+	{
+		if(packed[i] < '0' || packed[i] >= '0' + SPECTRUM_LEVELS * SPECTRUM_LEVELS)
+		{
+			return FALSE;
+		}
+	}
+
+	for(int i=0; i<SPECTRUM_BARS / 2; i++)
+	{
+		unsigned char pair = packed[i] - '0';
+
+		heights[2 * i] = pair >> 3;
+		heights[2 * i + 1] = pair & (SPECTRUM_LEVELS - 1);
+	}
+
+	return TRUE;
+}
+
+// Forget the contents of the string cache
+void clearStringCache(void)
+{
+	memset(strSlots, 0, sizeof(strSlots));
+}
@@ -0,0 +1,89 @@
+/*
+ * Parsers for the messages the router sends over the serial line. These
+ * only depend on the C library, so they can also be built and exercised
+ * on a host machine.
+ */
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include "common.h"
+
+#define MAX_DIR_ENTRIES	4		// Number of browse entries in a single response (one per LCD line)
+
+// String cache. The router keeps track of what the cache holds, and sends a
+// string that is already there as a reference to its slot. See interface.pl.
+// A reference carries a check character, so a slot that missed its store
+// (a lost line) is noticed instead of showing the string that was there before.
+#define NUM_STR_SLOTS	8		// Strings in the cache
+#define STR_REF			'\x01'	// Followed by '0' + slot and the check character: the string in that slot
+#define STR_CHECK_MASK	0x3F	// Check character: '0' + the sum of the string's characters, masked with this
+#define STR_STORE		'\x02'	// Followed by '0' + slot and a string: store the string in that slot, and use it
+#define STR_PREFIX		'\x03'	// Followed by '0' + length: response entry that starts like the one before it
+
+// Playback states, as reported in the state: field
+#define STATE_STOP		0
+#define STATE_PLAY		1
+#define STATE_PAUSE		2
+
+// Volume as reported when MPD has no mixer, and until the router has sent one
+#define VOLUME_UNKNOWN	-1
+
+// Flags returned by processPlayingLine(), one for each field found in the line
+#define FOUND_ARTIST	0x01
+#define FOUND_TITLE		0x02
+#define FOUND_NAME		0x04
+#define FOUND_PLLENGTH	0x08
+#define FOUND_SONG		0x10
+#define FOUND_TIME		0x20
+#define FOUND_STATE		0x40
+#define FOUND_VOLUME	0x80
+#define FOUND_NEXTARTIST	0x100
+#define FOUND_NEXTTITLE	0x200
+#define FOUND_AUDIO		0x400
+#define FOUND_BITRATE	0x800
+#define FOUND_QUEUEMINS	0x1000
+#define FOUND_BAD_REF	0x8000	// Not a field: a reference to a cache slot that does not hold the string
+
+#define FOUND_TRACK		(FOUND_ARTIST | FOUND_TITLE | FOUND_NAME)
+#define FOUND_NEXT		(FOUND_NEXTARTIST | FOUND_NEXTTITLE)
+
+// Topics the firmware subscribes to with "cmd:sub <mask>". The router only
+// pushes the fields of the topics subscribed to, and sends them in full when
+// the subscription changes. After a hello, everything is subscribed to.
+#define TOPIC_TRACK		0x01	// Artist, Title, Name, song, time, state
+#define TOPIC_VOLUME	0x02	// volume
+#define TOPIC_QUEUE		0x04	// playlistlength
+#define TOPIC_EXTRAS	0x08	// The line with nextartist, nexttitle, audio, bitrate, queuemins
+#define TOPIC_ALL		(TOPIC_TRACK | TOPIC_VOLUME | TOPIC_QUEUE | TOPIC_EXTRAS)
+#define TOPIC_SPECTRUM	0x10	// "spec: " lines from spectrum.pl. Not part of TOPIC_ALL.
+
+// Spectrum line: "spec: " and SPECTRUM_BARS / 2 characters, each '0' plus two
+// bar heights of 3 bits (the first bar in the upper bits)
+#define SPECTRUM_BARS	20
+#define SPECTRUM_LEVELS	8		// Heights 0..7
+
+// Everything the router tells us about what is currently playing
+typedef struct
+{
+	char artist[STR_LEN];	// Artist name, or the stream name when playing a stream
+	char title[STR_LEN];	// Title of current song
+	int playlistLength;		// Length of the playlist
+	int songNum;			// song number in the current playlist
+	int songTime;			// Total length of the song in seconds
+	int songElapsed;		// Elapsed time within the song in seconds
+	unsigned char state;	// STATE_STOP, STATE_PLAY or STATE_PAUSE
+	int volume;				// Mixer volume, 0-100, or VOLUME_UNKNOWN
+	char nextArtist[STR_LEN];	// Artist (or stream name) of the next song in the playlist, empty if there is none
+	char nextTitle[STR_LEN];	// Title of the next song in the playlist
+	char audio[STR_LEN];	// Sample format, as formatted by the router (e.g. "44.1kHz 16bit stereo")
+	int bitrate;			// Bitrate of the current song or stream in kbps
+	int queueMinutes;		// Total duration of the playlist in minutes
+} PlayerStatus;
+
+BOOL processResponse(const char *RXserbuffer, char entries[][STR_LEN], int *numEntries);
+unsigned int processPlayingLine(const char *RXserbuffer, PlayerStatus *status);
+BOOL processSpectrumLine(const char *RXserbuffer, unsigned char *heights);
+void clearStringCache(void);
+
+#endif
@@ -0,0 +1,62 @@
+# Summarise static SRAM use per object file from an avr-ld linker map.
+# Counts the input sections that end up in SRAM (.data, which on the AVR
+# also holds constant strings that are not in PROGMEM, .bss, .noinit and
+# COMMON symbols).
+#
+# Usage: awk -v sram=2048 -f ramreport.awk main.map
+
+function hex(s,    i, c, v)
+{
+	v = 0
+	s = tolower(substr(s, 3))
+	for(i = 1; i <= length(s); i++)
+	{
+		c = index("0123456789abcdef", substr(s, i, 1)) - 1
+		v = v * 16 + c
+	}
+	return v
+}
+
+function account(name, size, object)
+{
+	if(size == 0)
+		return
+	sub(/^.*\//, "", object)
+	if(name ~ /^\.bss|^COMMON|^\.noinit/)
+		bss[object] += size
+	else
+		data[object] += size
+	objects[object] = 1
+}
+
+# Output sections start in column 0
+/^\.data|^\.bss|^\.noinit/	{ insram = 1; next }
+/^[^ ]/						{ insram = 0; pending = ""; next }
+
+insram && $1 ~ /^(\.data|\.rodata|\.bss|\.noinit|COMMON)/ {
+	if(NF == 1)
+	{
+		pending = $1	# Long section names continue on the next line
+		next
+	}
+	if(NF >= 4 && $2 ~ /^0x/ && $3 ~ /^0x/)
+		account($1, hex($3), $4)
+	next
+}
+
+insram && pending != "" && NF >= 3 && $1 ~ /^0x/ && $2 ~ /^0x/ {
+	account(pending, hex($2), $3)
+	pending = ""
+}
+
+END {
+	printf "%-24s %8s %8s\n", "object", ".data", ".bss"
+	for(o in objects)
+	{
+		printf "%-24s %8d %8d\n", o, data[o], bss[o]
+		totaldata += data[o]
+		totalbss += bss[o]
+	}
+	printf "%-24s %8d %8d\n", "total", totaldata, totalbss
+	printf "SRAM: %d of %d bytes static, %d left for stack\n", totaldata + totalbss, sram, sram - totaldata - totalbss
+}
@@ -0,0 +1,200 @@
+/*
+ * Cooperative task scheduler, see sched.h
+ */
+
+//=========== Includes ===========
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+#include "sched.h"
+
+//=========== Defines ===========
+
+#define	TICKS_PER_MS	(F_CPU / 64 / 1000)		// Timer0 counts per 1 ms tick
+#define	STACK_PAINT		0xC5					// Fill of the SRAM the stack has not reached
+
+//=========== Local variables ===========
+
+typedef struct
+{
+	void (*run)(void);
+	unsigned int period;		// ms between runs
+	unsigned int deadline;		// ms a run may start late before it counts as a miss
+	unsigned int nextRun;		// Tick at which the task is due next
+	unsigned int worstCase;		// Longest run so far, in Timer1 counts
+	unsigned int misses;		// Number of runs that started after their deadline
+} Task;
+
+static Task tasks[SCHED_MAX_TASKS];
+static unsigned char numTasks;
+static volatile unsigned int ticks;		// ms since schedInit()
+
+#ifdef __AVR__
+extern unsigned char __heap_start;		// First byte after the variables, from the linker script
+#endif
+
+//=========== Startup code ===========
+
+#ifdef __AVR__
+// Fill the SRAM between the variables and the stack with STACK_PAINT, before
+// main() runs. Naked and in .init3, so it uses no stack itself.
+void schedPaintStack(void) __attribute__((naked, used, section(".init3")));
+void schedPaintStack(void)
+{
+	for(unsigned char *p = &__heap_start; p < (unsigned char *)SP; p++)
+	{
+		*p = STACK_PAINT;
+	}
+}
+#endif
+
+//=========== Interrupt handlers ===========
+
+ISR(TIMER0_COMPA_vect)
+{
+	ticks++;
+}
+
+//=========== Public functions ===========
+
+// Start the 1 ms tick and the execution time counter
+void schedInit(void)
+{
+	// Timer0 in CTC mode, F_CPU/64, compare match every ms
+	TCCR0A = (1 << WGM01);
+	TCCR0B = (1 << CS01) | (1 << CS00);
+	OCR0A = TICKS_PER_MS - 1;
+	TIMSK0 |= (1 << OCIE0A);
+
+	// Timer1 free running at F_CPU/64, no interrupts
+	TCCR1A = 0;
+	TCCR1B = (1 << CS11) | (1 << CS10);
+	TIMSK1 = 0;
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+// Add a task, which is first due right away. Returns its number, for the
+// statistics functions, or SCHED_MAX_TASKS if there is no room for it.
+unsigned char schedAddTask(void (*run)(void), unsigned int period, unsigned int deadline)
+{
+	Task *task;
+
+	if(numTasks >= SCHED_MAX_TASKS)
+	{
+		return SCHED_MAX_TASKS;
+	}
+
+	task = &tasks[numTasks];
+	task->run = run;
+	task->period = period;
+	task->deadline = deadline;
+	task->nextRun = schedNow();
+
+	return numTasks++;
+}
+
+// Current tick count, in ms. Wraps around after 65 seconds, so only compare
+// differences.
+unsigned int schedNow(void)
+{
+	unsigned int now;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = ticks;
+	}
+
+	return now;
+}
+
+// Longest execution time of a task so far, in microseconds
+unsigned int schedWorstCase(unsigned char task)
+{
+	return tasks[task].worstCase * SCHED_US_PER_COUNT;
+}
+
+// Number of times a task started after its deadline
+unsigned int schedMisses(unsigned char task)
+{
+	return tasks[task].misses;
+}
+
+unsigned char schedNumTasks(void)
+{
+	return numTasks;
+}
+
+// Bytes of SRAM the stack has not reached since the reset: the headroom left
+// by the deepest call chain, interrupts included. Always 0 in a host build.
+unsigned int schedStackUnused(void)
+{
+#ifdef __AVR__
+	const unsigned char *p = &__heap_start;
+
+	while(p < (const unsigned char *)SP && *p == STACK_PAINT)
+	{
+		p++;
+	}
+
+	return p - &__heap_start;
+#else
+	return 0;
+#endif
+}
+
+// Run the tasks forever
+void schedRun(void)
+{
+	for(;;)
+	{
+		BOOL ran = FALSE;
+
+		for(unsigned char i=0; i<numTasks; i++)
+		{
+			Task *task = &tasks[i];
+			unsigned int late = schedNow() - task->nextRun;
+
+			if((int)late < 0)
+			{
+				continue;	// Not due yet
+			}
+
+			if(late > task->deadline)
+			{
+				task->misses++;
+			}
+
+			unsigned int start = TCNT1;
+			task->run();
+			unsigned int duration = TCNT1 - start;
+			if(duration > task->worstCase)
+			{
+				task->worstCase = duration;
+			}
+
+			// Releases that were missed altogether are skipped, not caught up on
+			task->nextRun += task->period;
+			if((int)(schedNow() - task->nextRun) >= 0)
+			{
+				task->nextRun = schedNow() + task->period;
+			}
+			ran = TRUE;
+		}
+
+		// Idle: sleep until the next tick or serial interrupt. The instruction
+		// after sei() always executes, so an interrupt pending at that point
+		// wakes the CPU right away instead of being slept through.
+		if(!ran)
+		{
+			cli();
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		}
+	}
+}
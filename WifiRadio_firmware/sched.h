@@ -0,0 +1,35 @@
+/*
+ * Cooperative, run-to-completion task scheduler.
+ *
+ * Timer0 provides a 1 ms tick. Each task runs every 'period' ticks; if it
+ * gets to run more than 'deadline' ticks after it was due, that counts as a
+ * missed deadline. Tasks must return quickly, as nothing else runs until
+ * they do. When no task is due, the CPU sleeps until the next interrupt.
+ *
+ * Timer1 runs freely at F_CPU/64 and is used to measure the worst-case
+ * execution time of each task (interrupts taken while the task runs
+ * included). It must not be reconfigured by anything else.
+ *
+ * The SRAM between the variables and the stack is filled with a pattern at
+ * reset, so schedStackUnused() can tell how close the stack ever came to the
+ * variables.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "common.h"
+
+#define	SCHED_MAX_TASKS		4		// The firmware runs four tasks; each slot costs 12 bytes of SRAM
+#define	SCHED_US_PER_COUNT	4		// Timer1 resolution at F_CPU/64, in microseconds (for 16 MHz)
+
+void schedInit(void);
+unsigned char schedAddTask(void (*run)(void), unsigned int period, unsigned int deadline);
+unsigned int schedNow(void);
+unsigned int schedWorstCase(unsigned char task);
+unsigned int schedMisses(unsigned char task);
+unsigned char schedNumTasks(void);
+unsigned int schedStackUnused(void);
+void schedRun(void);
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Frame buffer for the LCD, see screen.h
+ */
+
+//=========== Includes ===========
+
+#include <string.h>
+
+#include "lcd.h"
+#include "glyph.h"
+#include "screen.h"
+
+//=========== Local variables ===========
+
+static char frame[LCD_LINES][LCD_WIDTH];	// The screen as it is being composed
+static char shown[LCD_LINES][LCD_WIDTH];	// What the display shows. Starts out as zeroes, which
+											// never match, so the first flush writes everything
+
+//=========== Public functions ===========
+
+// Clear the complete screen
+void screenClear(void)
+{
+	for(unsigned char line=0; line<LCD_LINES; line++)
+	{
+		screenClearLine(line);
+	}
+}
+
+// Clear one line of the screen, before composing it again. This also unpins
+// the custom characters the line used.
+void screenClearLine(unsigned char line)
+{
+	memset(frame[line], ' ', LCD_WIDTH);
+	glyphClearLine(line);
+}
+
+// Put a string on the screen, cut off at the right edge
+void screenPuts(unsigned char x, unsigned char line, const char *s)
+{
+	while(*s && x < LCD_WIDTH)
+	{
+		frame[line][x++] = *s++;
+	}
+}
+
+// Put a string on the screen, centered on the line
+void screenCenter(unsigned char line, const char *s)
+{
+	unsigned char len = strlen(s);
+
+	screenPuts(len < LCD_WIDTH ? (LCD_WIDTH - len) / 2 : 0, line, s);
+}
+
+// Bring the display up to date with the composed screen. Custom characters
+// are loaded first, then each run of changed characters is written with a
+// single cursor move.
+void screenFlush(void)
+{
+	glyphFlush();
+
+	for(unsigned char line=0; line<LCD_LINES; line++)
+	{
+		BOOL cursorValid = FALSE;
+
+		for(unsigned char x=0; x<LCD_WIDTH; x++)
+		{
+			if(frame[line][x] == shown[line][x])
+			{
+				cursorValid = FALSE;
+				continue;
+			}
+
+			if(!cursorValid)
+			{
+				lcd_gotoxy(x, line);
+				cursorValid = TRUE;
+			}
+			lcd_data(frame[line][x]);
+			shown[line][x] = frame[line][x];
+		}
+	}
+}
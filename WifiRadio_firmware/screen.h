@@ -0,0 +1,21 @@
+/*
+ * Frame buffer for the LCD.
+ *
+ * Screens are composed in RAM, and screenFlush() then writes only the
+ * characters that differ from what the display already shows. Redrawing a
+ * complete screen every time something changes is therefore cheap, and the
+ * display does not flicker the way it does after lcd_clrscr().
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include "common.h"
+
+void screenClear(void);
+void screenClearLine(unsigned char line);
+void screenPuts(unsigned char x, unsigned char line, const char *s);
+void screenCenter(unsigned char line, const char *s);
+void screenFlush(void);
+
+#endif
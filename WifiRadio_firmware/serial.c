@@ -0,0 +1,238 @@
+/*
+ * Interrupt driven serial link to the router, see serial.h
+ */
+
+//=========== Includes ===========
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include <string.h>
+
+#include "serial.h"
+
+//=========== Global Variables ===========
+
+volatile unsigned int gRXOverruns;
+volatile unsigned int gRXTruncations;
+volatile unsigned int gRXErrors;
+volatile unsigned int gTXOverruns;
+
+//=========== Local variables ===========
+
+static char rxBuffer[2][SER_BUFF_LEN];	// One buffer is filled by the ISR, the other one belongs to the parser
+static volatile unsigned char rxFill;	// Index of the buffer the ISR is currently filling
+static volatile BOOL rxLineReady;		// The other buffer holds a complete line that has not been released yet
+static unsigned char rxPos;				// Write position in the buffer being filled
+static BOOL rxTruncating;				// The current line overflowed, skip everything up to the newline
+
+static char txBuffer[SER_TX_LEN];
+static volatile unsigned char txHead;	// Next free position, written by putbytes()
+static volatile unsigned char txTail;	// Next character to send, written by the UDRE interrupt
+
+//=========== Startup code ===========
+
+#ifdef __AVR__
+// startBootloader() resets the chip through the watchdog, which stays on
+// after that reset. The bootloader turns it off, but without it the firmware
+// would be reset again 15 ms into main(). Naked and in .init3, before main()
+// runs; WDRF in MCUSR has to be cleared first, or WDE stays set.
+void serialWatchdogOff(void) __attribute__((naked, used, section(".init3")));
+void serialWatchdogOff(void)
+{
+	MCUSR = 0;
+	wdt_disable();
+}
+#endif
+
+//=========== Interrupt handlers ===========
+
+// A character was received
+ISR(USART_RX_vect)
+{
+	unsigned char status = UCSR0A;	// Must be read before UDR0
+	char c = UDR0;
+
+	if(status & ((1 << DOR0) | (1 << FE0)))
+	{
+		gRXErrors++;
+	}
+
+	if(c == '\r')
+	{
+		return;		// strip carriage returns in case data contains both CR&LF
+	}
+
+	if(c == '\n')
+	{
+		rxBuffer[rxFill][rxPos] = '\0';	// turn buffer into a string
+		rxPos = 0;
+		rxTruncating = FALSE;
+
+		if(rxLineReady)
+		{
+			// The parser still owns the other buffer, so the only option is to drop
+			// this line and reuse its buffer
+			gRXOverruns++;
+		}
+		else
+		{
+			rxFill ^= 1;
+			rxLineReady = TRUE;
+		}
+		return;
+	}
+
+	if(rxTruncating)
+	{
+		return;
+	}
+
+	if(rxPos >= SER_BUFF_LEN - 1)
+	{
+		// Keep what fits, and drop the rest of the line
+		gRXTruncations++;
+		rxTruncating = TRUE;
+		return;
+	}
+
+	rxBuffer[rxFill][rxPos++] = c;
+}
+
+// The UART is ready to accept the next character
+ISR(USART_UDRE_vect)
+{
+	if(txTail != txHead)
+	{
+		UDR0 = txBuffer[txTail];
+		txTail = (txTail + 1) & (SER_TX_LEN - 1);
+	}
+	else
+	{
+		UCSR0B &= ~(1 << UDRIE0);	// Nothing left to send
+	}
+}
+
+//=========== Local functions ===========
+
+// Queue len bytes for transmission. A message is either queued completely or,
+// if it does not fit in the transmit buffer, dropped completely, so the router
+// never sees half a command. Safe to call from interrupt handlers.
+static BOOL queueBytes(const char *data, unsigned char len, BOOL inFlash)
+{
+	BOOL result = FALSE;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		unsigned char used = (txHead - txTail) & (SER_TX_LEN - 1);
+
+		if(len < SER_TX_LEN - used)
+		{
+			for(unsigned char i=0; i<len; i++)
+			{
+				txBuffer[txHead] = inFlash ? pgm_read_byte(data + i) : data[i];
+				txHead = (txHead + 1) & (SER_TX_LEN - 1);
+			}
+			UCSR0B |= (1 << UDRIE0);	// Start sending
+			result = TRUE;
+		}
+		else
+		{
+			gTXOverruns++;
+		}
+	}
+
+	return result;
+}
+
+//=========== Public functions ===========
+
+void inituart(void)	// Initialize USART0 to desired baud rate
+{
+	// Set baud rate generator based on F_CPU
+	UBRR0H = (unsigned char)((F_CPU/(16UL*BAUD)-1)>>8);
+	UBRR0L = (unsigned char)(F_CPU/(16UL*BAUD)-1);
+	
+	// Enable USART0 transmitter and receiver, and the receive interrupt. The
+	// transmit interrupt is enabled whenever there is something to send.
+	UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0);
+}
+
+// Return the next complete line received from the router, or NULL if none is
+// available yet. The line stays valid until releaseline() is called.
+char *getline(void)
+{
+	if(!rxLineReady)
+	{
+		return NULL;
+	}
+
+	return rxBuffer[rxFill ^ 1];
+}
+
+// Hand the buffer returned by getline() back to the receiver
+void releaseline(void)
+{
+	rxLineReady = FALSE;
+}
+
+// Queue len bytes for transmission, see queueBytes()
+BOOL putbytes(const char *data, unsigned char len)
+{
+	return queueBytes(data, len, FALSE);
+}
+
+// Queue a zero-terminated string for transmission
+BOOL putstring(const char *buffer)
+{
+	size_t len = strlen(buffer);
+
+	if(len >= SER_TX_LEN)
+	{
+		gTXOverruns++;
+		return FALSE;
+	}
+
+	return queueBytes(buffer, len, FALSE);
+}
+
+// Queue a zero-terminated string from flash for transmission
+BOOL putstring_P(PGM_P buffer)
+{
+	size_t len = strlen_P(buffer);
+
+	if(len >= SER_TX_LEN)
+	{
+		gTXOverruns++;
+		return FALSE;
+	}
+
+	return queueBytes(buffer, len, TRUE);
+}
+
+// Sum of the link error counters. They are 16 bits wide and counted by the
+// interrupt handlers, so they are read with interrupts disabled.
+unsigned int serialErrors(void)
+{
+	unsigned int errors;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		errors = gRXOverruns + gRXTruncations + gRXErrors + gTXOverruns;
+	}
+
+	return errors;
+}
+
+// Hand the serial port over to the bootloader (see bootloader.c), when the
+// router sends "bootloader". The watchdog resets the chip, so the bootloader
+// finds everything in its reset state.
+void startBootloader(void)
+{
+	cli();
+	wdt_enable(WDTO_15MS);
+	for(;;)
+	{
+	}
+}
@@ -0,0 +1,34 @@
+/*
+ * Interrupt driven serial link to the router.
+ *
+ * Reception is double buffered: the RX interrupt fills one line buffer while
+ * the main loop parses the other, so parsing never holds up reception.
+ * Transmission goes through a ring buffer that is drained by the UDRE
+ * interrupt, so sending never busy-waits on the UART.
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "common.h"
+
+#define	SER_BUFF_LEN	200		// longest character line to accept from serial port
+#define	SER_TX_LEN		64		// size of the transmit ring buffer, must be a power of 2
+#define	BAUD			9600	// USART baud rate, must agree with router ttyS0 settings
+
+// Link error counters, for diagnostics
+extern volatile unsigned int gRXOverruns;		// Complete lines dropped because the previous line was still being parsed
+extern volatile unsigned int gRXTruncations;	// Lines longer than SER_BUFF_LEN that were cut short
+extern volatile unsigned int gRXErrors;			// Characters lost in the UART itself (data overrun or framing error)
+extern volatile unsigned int gTXOverruns;		// Messages dropped because the transmit buffer was full
+
+void inituart(void);
+char *getline(void);
+void releaseline(void);
+BOOL putbytes(const char *data, unsigned char len);
+BOOL putstring(const char *buffer);
+BOOL putstring_P(PGM_P buffer);
+unsigned int serialErrors(void);
+void startBootloader(void);
+
+#endif
@@ -0,0 +1,239 @@
+#!/usb/packages/usr/bin/perl -w
+
+# Spectrum analyzer for the bottom line of the playing screen. It reads the
+# PCM that MPD writes to a fifo audio output, e.g.
+#
+#   audio_output {
+#       type    "fifo"
+#       name    "spectrum"
+#       path    "/tmp/mpd.fifo"
+#       format  "44100:16:2"
+#   }
+#
+# and about 5 times per second reduces the latest stretch of audio to 20 bar
+# heights of 3 bits, sent to the AVR as "spec: " and 10 characters (see
+# processSpectrumLine() in parse.c). Such a line is 17 bytes, almost 2% of
+# the 9600 baud link per update per second, so the rate is kept low (9% at 5
+# updates per second) and a spectrum that did not change is not sent again
+# until $keepAlive passes. interface.pl starts it when SPECTRUM_FIFO is set,
+# and switches the output on (SIGUSR1) and off (SIGUSR2) as the firmware
+# subscribes to the spectrum and unsubscribes again. Each line goes out in a
+# single write, so it does not get mixed up with what interface.pl sends.
+#
+# A router has little CPU to spare, so instead of a full FFT there is one
+# Goertzel filter per bar, on a short window of mono audio that is first
+# decimated to a sample rate just above twice the highest bar frequency.
+# That is about 5000 multiply-adds per update with the defaults, and nothing
+# at all while the output is off.
+#
+# Usage: spectrum.pl [--fifo /tmp/mpd.fifo] [--tty /dev/tts/1] [--format 44100:16:2] [--rate 5]
+#                    [--window 256] [--minfreq 60] [--maxfreq 5000] [--on] [--print]
+#        spectrum.pl --bench recorded.pcm [--rate 5] [--print] ...
+#
+# Any file or named pipe with raw PCM in the given format can stand in for the
+# fifo; a plain file is played at real-time speed. --print writes the bars to
+# standard output instead of the serial port. --bench analyzes a file as fast
+# as it can, and reports the CPU time per update and the share of the CPU the
+# analyzer needs at --rate.
+
+use strict;
+use Getopt::Long;
+use Time::HiRes qw(time sleep);
+
+my $fifo = "/tmp/mpd.fifo";
+my $tty = "/dev/tts/1";
+my $format = "44100:16:2";
+my $rate = 5;                   # updates per second
+my $windowLength = 256;         # samples per analysis, after decimation
+my $minFreq = 60;               # centre frequencies of the first and last bar, in Hz
+my $maxFreq = 5000;
+my $dbPerLevel = 5;             # bar height step
+my $fallRate = 15;              # levels per second a bar falls, whatever the rate
+my $tilt = 3;                   # dB per octave added, as music has less energy in the treble
+my $keepAlive = 0.5;            # an unchanged spectrum is sent again after this many seconds
+my $sending = 0;
+my $print = 0;
+my $bench = "";
+
+GetOptions("fifo=s" => \$fifo, "tty=s" => \$tty, "format=s" => \$format, "rate=f" => \$rate,
+           "window=i" => \$windowLength, "minfreq=f" => \$minFreq, "maxfreq=f" => \$maxFreq,
+           "on" => \$sending, "print" => \$print, "bench=s" => \$bench) or die "Invalid options\n";
+
+my $numBars = 20;
+my $numLevels = 8;
+
+my ($sampleRate, $bits, $channels) = $format =~ /^(\d+):(\d+):(\d+)$/ or die "Invalid format $format\n";
+die "Only 16 bit samples are supported\n" unless $bits == 16;
+
+my $frameBytes = 2 * $channels;
+my $decimation = int($sampleRate / (2 * $maxFreq * 1.1)) || 1;
+my $groupSize = $decimation * $channels;       # samples averaged into one
+my $windowBytes = $windowLength * $decimation * $frameBytes;
+my $hopBytes = int($sampleRate / $rate) * $frameBytes;
+$hopBytes = $windowBytes if $hopBytes < $windowBytes;
+my $fall = int($fallRate / $rate + 0.5) || 1;      # levels a bar falls per update
+
+#=========== Filter bank ===========
+
+my @window = ();        # Hann window, with the averaging of each group folded in
+my @coeffs = ();        # Goertzel coefficient of each bar
+my @offsets = ();       # tilt and full-scale reference of each bar, in dB
+my @heights = (0) x $numBars;
+
+for my $i (0 .. $windowLength - 1)
+{
+    push(@window, (0.5 - 0.5 * cos(2 * 3.14159265 * $i / ($windowLength - 1))) / $groupSize);
+}
+
+# A full-scale sine comes out of a Hann-windowed Goertzel filter with an
+# amplitude of 32768 * N / 4
+my $fullScale = 20 * log(32768 * $windowLength / 4) / log(10);
+
+for my $bar (0 .. $numBars - 1)
+{
+    my $freq = $minFreq * ($maxFreq / $minFreq) ** ($bar / ($numBars - 1));
+    push(@coeffs, 2 * cos(2 * 3.14159265 * $freq * $decimation / $sampleRate));
+    push(@offsets, $tilt * log($freq / $minFreq) / log(2) - $fullScale);
+}
+
+# Reduce a window of PCM to bar heights. Bars rise at once and fall at
+# $fallRate levels per second, which is easier on the eye.
+sub analyze($)
+{
+    my ($pcm) = @_;
+    my @samples = unpack("s<*", $pcm);
+    my @x = ();
+
+    for my $i (0 .. $windowLength - 1)
+    {
+        my $sum = 0;
+        $sum += $_ for @samples[$i * $groupSize .. ($i + 1) * $groupSize - 1];
+        push(@x, $sum * $window[$i]);
+    }
+
+    for my $bar (0 .. $numBars - 1)
+    {
+        my $c = $coeffs[$bar];
+        my ($s1, $s2) = (0, 0);
+
+        for (@x)
+        {
+            my $s0 = $_ + $c * $s1 - $s2;
+            $s2 = $s1;
+            $s1 = $s0;
+        }
+
+        my $power = $s1 * $s1 + $s2 * $s2 - $c * $s1 * $s2;
+        my $db = ($power > 0 ? 10 * log($power) / log(10) : -200) + $offsets[$bar];
+        my $height = $numLevels - 1 + int($db / $dbPerLevel);
+
+        $height = 0 if $height < 0;
+        $height = $numLevels - 1 if $height > $numLevels - 1;
+        $height = $heights[$bar] - $fall if $height < $heights[$bar] - $fall;
+        $heights[$bar] = $height;
+    }
+}
+
+# Two bars per character, the first in the upper 3 bits
+sub packHeights()
+{
+    my $packed = "";
+
+    for(my $bar = 0; $bar < $numBars; $bar += 2)
+    {
+        $packed .= chr(ord("0") + $heights[$bar] * $numLevels + $heights[$bar + 1]);
+    }
+    return $packed;
+}
+
+#=========== Benchmark ===========
+
+if($bench ne "")
+{
+    open(PCM, "<", $bench) or die "Cannot open $bench: $!\n";
+    binmode(PCM);
+    local $/;
+    my $pcm = <PCM>;
+    close(PCM);
+
+    my $updates = 0;
+    my ($user, $system) = times();
+    my $start = time();
+
+    for(my $pos = 0; $pos + $windowBytes <= length($pcm); $pos += $hopBytes)
+    {
+        analyze(substr($pcm, $pos, $windowBytes));
+        print packHeights()."\n" if $print;
+        $updates++;
+    }
+
+    my ($user2, $system2) = times();
+    my $cpu = $user2 - $user + $system2 - $system;
+    die "$bench holds less than one window of audio\n" unless $updates;
+
+    printf("%d updates of %d bars (window %d, decimation %d) in %.2f s CPU, %.2f s wall\n",
+           $updates, $numBars, $windowLength, $decimation, $cpu, time() - $start);
+    printf("%.2f ms CPU per update, %.1f%% of the CPU at %g updates per second\n",
+           1000 * $cpu / $updates, 100 * $cpu / $updates * $rate, $rate);
+    exit(0);
+}
+
+#=========== Live ===========
+
+$SIG{USR1} = sub { $sending = 1; };
+$SIG{USR2} = sub { $sending = 0; };
+$SIG{PIPE} = "IGNORE";
+
+open(TTY, ">>", $tty) or die "Cannot open $tty: $!\n" unless $print;
+$| = 1;
+
+my $lastLine = "";
+my $lastSendTime = 0;
+my $nextUpdate = time();
+
+# Opening the fifo waits until MPD starts playing, and reading it ends when
+# MPD stops; then it is opened again
+while(1)
+{
+    open(PCM, "<", $fifo) or die "Cannot open $fifo: $!\n";
+    binmode(PCM);
+
+    my $pcm = "";
+    while(1)
+    {
+        my $got = sysread(PCM, $pcm, $hopBytes - length($pcm), length($pcm));
+        next if !defined $got and $!{EINTR};    # a signal switched the output on or off
+        last if !$got;
+        next if length($pcm) < $hopBytes;
+
+        # A plain file would be read much faster than real time
+        my $now = time();
+        sleep($nextUpdate - $now) if $nextUpdate > $now;
+        $nextUpdate = ($nextUpdate > $now - 1 ? $nextUpdate : $now) + 1 / $rate;
+
+        if($sending)
+        {
+            analyze(substr($pcm, -$windowBytes));
+            my $line = "spec: ".packHeights()."\n";
+
+            if($print)
+            {
+                print $line;
+            }
+            elsif($line ne $lastLine or time() - $lastSendTime >= $keepAlive)
+            {
+                syswrite(TTY, $line);
+                $lastLine = $line;
+                $lastSendTime = time();
+            }
+        }
+        $pcm = "";
+    }
+    close(PCM);
+
+    @heights = (0) x $numBars;
+    if(-f $fifo)
+    {
+        exit(0);    # a recording has no more to come
+    }
+}
@@ -0,0 +1,26 @@
+/*
+ * Timing for the host benchmarks in this directory
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <time.h>
+
+#define BENCH_RUNS		20		// Each benchmark is run this often, and the fastest run counts
+
+static inline double benchSeconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Keeps the compiler from optimising away a result nobody looks at
+static inline void benchUse(const void *p)
+{
+	__asm__ __volatile__("" : : "r"(p) : "memory");
+}
+
+#endif
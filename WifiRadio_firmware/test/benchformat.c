@@ -0,0 +1,127 @@
+/*
+ * The formatters in format.c against the sprintf() calls they replaced, on the
+ * host. First every formatter is checked against sprintf() for every 16-bit
+ * input (exits with 1 on a difference), then both are timed on the values the
+ * firmware formats most: the elapsed time of every status line and the
+ * parameters of browse commands.
+ *
+ * This only measures the host's sprintf(). On the AVR, vfprintf() also costs
+ * its flash (it is not linked at all any more, see "avr-nm main.elf"), and
+ * has no divide instruction to fall back on either way.
+ *
+ * Usage: benchformat [iterations]
+ */
+
+//=========== Includes ===========
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../format.h"
+#include "bench.h"
+
+//=========== Defines ===========
+
+#define NUM_VALUES		64		// Values each benchmark cycles through
+
+//=========== Local variables ===========
+
+static unsigned int values[NUM_VALUES];
+static int failures;
+
+//=========== Local functions ===========
+
+static void check(const char *what, unsigned int input, const char *got, const char *expected)
+{
+	if(strcmp(got, expected) && failures++ < 10)
+	{
+		fprintf(stderr, "%s(%u): \"%s\", sprintf gives \"%s\"\n", what, input, got, expected);
+	}
+}
+
+static void checkAll(void)
+{
+	char got[40], expected[40];
+
+	for(unsigned int i=0; i<=0xFFFF; i++)
+	{
+		formatNumber(got, i);
+		sprintf(expected, "%u", i);
+		check("formatNumber", i, got, expected);
+
+		formatTime(got, i);
+		sprintf(expected, "%u:%02u", i / 60, i % 60);
+		check("formatTime", i, got, expected);
+
+		formatPosition(got, i, 0xFFFF - i);
+		sprintf(expected, "(%u of %u)", i, 0xFFFF - i);
+		check("formatPosition", i, got, expected);
+
+		formatCommand(got, PSTR("gettracks"), i, 0xFFFF - i);
+		sprintf(expected, "cmd:%s %u %u\n", "gettracks", i, 0xFFFF - i);
+		check("formatCommand", i, got, expected);
+
+		formatCommandParam(got, PSTR("setvol"), i);
+		sprintf(expected, "cmd:%s %u\n", "setvol", i);
+		check("formatCommandParam", i, got, expected);
+	}
+}
+
+// Fastest of BENCH_RUNS runs, in ns per call
+#define BENCH(call)															\
+	({																		\
+		char buffer[40];													\
+		double best = 1e9;													\
+		for(int run=0; run<BENCH_RUNS; run++)								\
+		{																	\
+			double start = benchSeconds();									\
+			for(long i=0; i<iterations; i++)								\
+			{																\
+				unsigned int v = values[i % NUM_VALUES];					\
+				call;														\
+				benchUse(buffer);											\
+			}																\
+			double elapsed = benchSeconds() - start;						\
+			if(elapsed < best)												\
+			{																\
+				best = elapsed;												\
+			}																\
+		}																	\
+		best / iterations * 1e9;											\
+	})
+
+//=========== Main ===========
+
+int main(int argc, char *argv[])
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 100000;
+
+	checkAll();
+	if(failures)
+	{
+		fprintf(stderr, "%d differences from sprintf\n", failures);
+		return 1;
+	}
+
+	// Elapsed times of a few minutes, playlist positions and list indices
+	srand(1);
+	for(int i=0; i<NUM_VALUES; i++)
+	{
+		values[i] = rand() % 600;
+	}
+
+	printf("ns per call, best of %d runs of %ld\n", BENCH_RUNS, iterations);
+	printf("%-24s %8s %8s\n", "", "sprintf", "format.c");
+	printf("%-24s %8.1f %8.1f\n", "m:ss",
+		BENCH(sprintf(buffer, "%u:%02u", v / 60, v % 60)),
+		BENCH(formatTime(buffer, v)));
+	printf("%-24s %8.1f %8.1f\n", "(n of m)",
+		BENCH(sprintf(buffer, "(%u of %u)", v, v + 10)),
+		BENCH(formatPosition(buffer, v, v + 10)));
+	printf("%-24s %8.1f %8.1f\n", "cmd:<verb> <a> <b>",
+		BENCH(sprintf(buffer, "cmd:%s %u %u\n", "gettracks", v, v & 3)),
+		BENCH(formatCommand(buffer, PSTR("gettracks"), v, v & 3)));
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Throughput of processPlayingLine() on the host, against the parser it
+ * replaced (oldparse.c). The old parser only knows the line the router sent
+ * at the time, so that line is the fair comparison; the others show what the
+ * lines of the current protocol cost.
+ *
+ * Usage: benchparse [iterations]
+ */
+
+//=========== Includes ===========
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../parse.h"
+#include "bench.h"
+
+//=========== Function prototypes ===========
+
+void oldProcessPlayingLine(char *RXserbuffer, char *artist, char *title,
+						int *playlistLength, int *songNum, int *songTime, int *songElapsed);
+
+//=========== Local variables ===========
+
+static const char oldLine[] = "Artist: Daft Punk Title: Harder, Better, Faster, Str playlistlength: 14 song: 3 time: 35:224 ";
+static const char statusLine[] = "Artist: Daft Punk Title: Harder, Better, Faster, Str volume: 80 playlistlength: 14 state: play song: 3 time: 35:224 ";
+static const char cachedLine[] = "Artist: \x01" "0m Title: \x01" "1R volume: 80 playlistlength: 14 state: play song: 3 time: 36:224 ";
+static const char extrasLine[] = "nextartist: Air nexttitle: Sexy Boy audio: 44.1kHz 16bit stereo bitrate: 320 queuemins: 43 ";
+static const char timeLine[] = "time: 37:224 ";
+
+//=========== Local functions ===========
+
+// Both parsers get a fresh copy of the line each time, as the old one writes into it
+static double benchOld(const char *line, long iterations)
+{
+	char buffer[200];
+	char artist[STR_LEN], title[STR_LEN];
+	int playlistLength, songNum, songTime, songElapsed;
+	double best = 1e9;
+
+	for(int run=0; run<BENCH_RUNS; run++)
+	{
+		double start = benchSeconds();
+
+		for(long i=0; i<iterations; i++)
+		{
+			strcpy(buffer, line);
+			oldProcessPlayingLine(buffer, artist, title, &playlistLength, &songNum, &songTime, &songElapsed);
+			benchUse(artist);
+		}
+
+		double elapsed = benchSeconds() - start;
+		if(elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+
+	return best / iterations * 1e9;
+}
+
+static double benchNew(const char *line, long iterations)
+{
+	char buffer[200];
+	PlayerStatus status;
+	double best = 1e9;
+
+	memset(&status, 0, sizeof(status));
+	for(int run=0; run<BENCH_RUNS; run++)
+	{
+		double start = benchSeconds();
+
+		for(long i=0; i<iterations; i++)
+		{
+			strcpy(buffer, line);
+			processPlayingLine(buffer, &status);
+			benchUse(&status);
+		}
+
+		double elapsed = benchSeconds() - start;
+		if(elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+
+	return best / iterations * 1e9;
+}
+
+//=========== Main ===========
+
+int main(int argc, char *argv[])
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 100000;
+	PlayerStatus status;
+
+	// Fill the string cache, so the references in cachedLine resolve
+	memset(&status, 0, sizeof(status));
+	processPlayingLine("Artist: \x02" "0Daft Punk Title: \x02" "1Harder, Better, Faster, Str ", &status);
+
+	printf("ns per line, best of %d runs of %ld\n", BENCH_RUNS, iterations);
+	printf("%-24s %8s %8s\n", "line", "old", "new");
+	printf("%-24s %8.1f %8.1f\n", "old protocol", benchOld(oldLine, iterations), benchNew(oldLine, iterations));
+	printf("%-24s %8s %8.1f\n", "status", "-", benchNew(statusLine, iterations));
+	printf("%-24s %8s %8.1f\n", "status, cached strings", "-", benchNew(cachedLine, iterations));
+	printf("%-24s %8s %8.1f\n", "extras", "-", benchNew(extrasLine, iterations));
+	printf("%-24s %8s %8.1f\n", "time only", "-", benchNew(timeLine, iterations));
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * The string functions the parsers use, one byte at a time the way avr-libc
+ * implements them. benchparse-bytewise is linked against these instead of the
+ * host C library, whose vectorised versions make a strstr() pass over a line
+ * almost free and so hide what a pass costs on the AVR.
+ */
+
+//=========== Includes ===========
+
+#include <string.h>
+
+//=========== Public functions ===========
+
+size_t strlen(const char *s)
+{
+	const char *p = s;
+
+	while(*p)
+	{
+		p++;
+	}
+	return p - s;
+}
+
+char *strchr(const char *s, int c)
+{
+	for(;; s++)
+	{
+		if(*s == (char)c)
+		{
+			return (char *)s;
+		}
+		if(!*s)
+		{
+			return NULL;
+		}
+	}
+}
+
+void *memchr(const void *s, int c, size_t n)
+{
+	const unsigned char *p = s;
+
+	for(; n; n--, p++)
+	{
+		if(*p == (unsigned char)c)
+		{
+			return (void *)p;
+		}
+	}
+	return NULL;
+}
+
+int strcmp(const char *a, const char *b)
+{
+	while(*a && *a == *b)
+	{
+		a++;
+		b++;
+	}
+	return (unsigned char)*a - (unsigned char)*b;
+}
+
+int strncmp(const char *a, const char *b, size_t n)
+{
+	for(; n; n--, a++, b++)
+	{
+		if(*a != *b || !*a)
+		{
+			return (unsigned char)*a - (unsigned char)*b;
+		}
+	}
+	return 0;
+}
+
+int memcmp(const void *a, const void *b, size_t n)
+{
+	const unsigned char *p = a;
+	const unsigned char *q = b;
+
+	for(; n; n--, p++, q++)
+	{
+		if(*p != *q)
+		{
+			return *p - *q;
+		}
+	}
+	return 0;
+}
+
+char *strstr(const char *s, const char *key)
+{
+	if(!*key)
+	{
+		return (char *)s;
+	}
+
+	for(; *s; s++)
+	{
+		const char *p = s;
+		const char *k = key;
+
+		while(*k && *p == *k)
+		{
+			p++;
+			k++;
+		}
+		if(!*k)
+		{
+			return (char *)s;
+		}
+	}
+	return NULL;
+}
+
+char *strcpy(char *dest, const char *src)
+{
+	char *d = dest;
+
+	while((*d++ = *src++))
+	{
+	}
+	return dest;
+}
+
+char *strncpy(char *dest, const char *src, size_t n)
+{
+	char *d = dest;
+
+	for(; n && *src; n--)
+	{
+		*d++ = *src++;
+	}
+	for(; n; n--)
+	{
+		*d++ = '\0';
+	}
+	return dest;
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+	unsigned char *d = dest;
+	const unsigned char *s = src;
+
+	while(n--)
+	{
+		*d++ = *s++;
+	}
+	return dest;
+}
@@ -0,0 +1,251 @@
+/*
+ * Fuzz harness for the parsers in parse.c, built on the host with AddressSanitizer
+ * and UndefinedBehaviorSanitizer (see the Makefile in this directory).
+ *
+ * An input is cut into lines the way the serial interrupt does it: carriage
+ * returns are dropped, a newline ends a line and lines are truncated to
+ * SER_BUFF_LEN - 1 characters. Every line goes through all parsers, so the
+ * string cache filled by one line is used by the next. Each line is copied to
+ * a buffer of exactly its size, so the sanitizers catch a read past its end.
+ *
+ * Built with clang -fsanitize=fuzzer (make FUZZER=libfuzzer) libFuzzer calls
+ * LLVMFuzzerTestOneInput(). Otherwise main() runs every file given on the
+ * command line, which is how AFL calls it, and with -n <count> also that many
+ * random mutations of those files, for hosts without libFuzzer or AFL.
+ */
+
+//=========== Includes ===========
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../parse.h"
+
+//=========== Defines ===========
+
+#define SER_BUFF_LEN	200		// As in serial.h, which cannot be included on the host
+#define MAX_INPUT		1024	// Longest input the mutator makes
+
+//=========== Local functions ===========
+
+// Check that a string the parsers filled in is terminated within its buffer
+static void checkString(const char *s, const char *what)
+{
+	if(memchr(s, '\0', STR_LEN) == NULL)
+	{
+		fprintf(stderr, "%s is not terminated\n", what);
+		abort();
+	}
+}
+
+static void parseLine(const char *line, size_t len, PlayerStatus *status)
+{
+	char entries[MAX_DIR_ENTRIES][STR_LEN];
+	unsigned char heights[SPECTRUM_BARS];
+	int numEntries = -1;
+	char *buffer = malloc(len + 1);
+
+	memcpy(buffer, line, len);
+	buffer[len] = '\0';
+	memset(entries, 'x', sizeof(entries));
+
+	if(processResponse(buffer, entries, &numEntries))
+	{
+		if(numEntries < 0 || numEntries > MAX_DIR_ENTRIES)
+		{
+			fprintf(stderr, "numEntries is %d\n", numEntries);
+			abort();
+		}
+		for(int i=0; i<MAX_DIR_ENTRIES; i++)
+		{
+			checkString(entries[i], "entry");
+		}
+	}
+
+	processPlayingLine(buffer, status);
+	checkString(status->artist, "artist");
+	checkString(status->title, "title");
+	checkString(status->nextArtist, "nextArtist");
+	checkString(status->nextTitle, "nextTitle");
+	checkString(status->audio, "audio");
+
+	if(processSpectrumLine(buffer, heights))
+	{
+		for(int i=0; i<SPECTRUM_BARS; i++)
+		{
+			if(heights[i] >= SPECTRUM_LEVELS)
+			{
+				fprintf(stderr, "bar %d is %d high\n", i, heights[i]);
+				abort();
+			}
+		}
+	}
+
+	free(buffer);
+}
+
+static void parseInput(const uint8_t *data, size_t size)
+{
+	char line[SER_BUFF_LEN];
+	size_t len = 0;
+	PlayerStatus status;
+
+	memset(&status, 0, sizeof(status));
+	clearStringCache();
+
+	for(size_t i=0; i<size; i++)
+	{
+		if(data[i] == '\r')
+		{
+			continue;
+		}
+		if(data[i] == '\n')
+		{
+			parseLine(line, len, &status);
+			len = 0;
+		}
+		else if(len < SER_BUFF_LEN - 1)
+		{
+			line[len++] = data[i];
+		}
+	}
+	parseLine(line, len, &status);
+}
+
+//=========== Entry points ===========
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	parseInput(data, size);
+	return 0;
+}
+
+#ifndef LIBFUZZER
+
+// Field names and markers the mutator inserts, as in parse.dict
+static const char *tokens[] =
+{
+	"Artist: ", "Title: ", "Name: ", "playlistlength: ", "song: ", "time: ",
+	"state: ", "volume: ", "nextartist: ", "nexttitle: ", "audio: ",
+	"bitrate: ", "queuemins: ", "resp: ", "spec: ", ": ", ",", "\n",
+	"\x01" "0", "\x01" "0m", "\x01" "7", "\x01" "9", "\x02" "0", "\x02" "8", "\x03" "5", "\x03" "z",
+	"99999999", "-1", "play", "pause"
+};
+#define NUM_TOKENS	(sizeof(tokens) / sizeof(tokens[0]))
+
+static size_t mutate(uint8_t *data, size_t size)
+{
+	int count = 1 + rand() % 8;
+
+	while(count--)
+	{
+		size_t pos = size ? rand() % (size + 1) : 0;
+		const char *token;
+		size_t len;
+
+		switch(rand() % 5)
+		{
+		case 0:		// Change a byte
+			if(pos < size)
+			{
+				data[pos] = rand();
+			}
+			break;
+		case 1:		// Drop some bytes
+			len = rand() % 16;
+			if(pos + len <= size)
+			{
+				memmove(data + pos, data + pos + len, size - pos - len);
+				size -= len;
+			}
+			break;
+		case 2:		// Insert a field name or marker
+			token = tokens[rand() % NUM_TOKENS];
+			len = strlen(token);
+			if(size + len <= MAX_INPUT)
+			{
+				memmove(data + pos + len, data + pos, size - pos);
+				memcpy(data + pos, token, len);
+				size += len;
+			}
+			break;
+		case 3:		// Repeat a piece of the input
+			len = rand() % 32;
+			if(pos + len <= size && size + len <= MAX_INPUT)
+			{
+				memmove(data + pos + len, data + pos, size - pos);
+				size += len;
+			}
+			break;
+		default:	// Cut the input short
+			size = pos;
+			break;
+		}
+	}
+
+	return size;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t inputs[64][MAX_INPUT];
+	static size_t sizes[64];
+	int numInputs = 0;
+	long mutations = 0;
+
+	for(int i=1; i<argc; i++)
+	{
+		if(!strcmp(argv[i], "-n") && i + 1 < argc)
+		{
+			mutations = atol(argv[++i]);
+			continue;
+		}
+		if(!strcmp(argv[i], "-s") && i + 1 < argc)
+		{
+			srand(atoi(argv[++i]));
+			continue;
+		}
+
+		FILE *file = fopen(argv[i], "rb");
+		if(!file)
+		{
+			perror(argv[i]);
+			return 1;
+		}
+		if(numInputs < 64)
+		{
+			sizes[numInputs] = fread(inputs[numInputs], 1, MAX_INPUT, file);
+			parseInput(inputs[numInputs], sizes[numInputs]);
+			numInputs++;
+		}
+		fclose(file);
+	}
+
+	if(numInputs == 0)
+	{
+		// AFL passes the input on stdin when there is no @@ on its command line
+		static uint8_t input[MAX_INPUT];
+		size_t size = fread(input, 1, MAX_INPUT, stdin);
+
+		parseInput(input, size);
+		return 0;
+	}
+
+	for(long n=0; n<mutations; n++)
+	{
+		uint8_t data[MAX_INPUT];
+		int from = rand() % numInputs;
+		size_t size = sizes[from];
+
+		memcpy(data, inputs[from], size);
+		size = mutate(data, size);
+		parseInput(data, size);
+	}
+
+	printf("%d inputs and %ld mutations parsed\n", numInputs, mutations);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for <avr/interrupt.h>. Interrupt handlers are plain functions,
+ * which hostboard.c calls from its own thread, and cli() and sei() take and
+ * release the lock that keeps them out.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define ISR(vector)	void vector(void)
+
+#define cli()	hostCli()
+#define sei()	hostSei()
+
+void hostCli(void);
+void hostSei(void);
+
+// The interrupts the firmware handles
+void TIMER0_COMPA_vect(void);
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Host stand-in for <avr/io.h>, for the host build of the firmware (see
+ * hostboard.c). The registers the firmware uses are plain variables, which
+ * hostboard.c reads and writes where the hardware would.
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+//=========== Registers ===========
+
+// UDR0 is wider than a byte, so hostboard.c can tell whether the transmit
+// interrupt wrote it (see HOST_UDR_EMPTY)
+#define UDR0	hostUDR0
+#define TCNT1	hostTimer1()
+
+extern volatile int hostUDR0;
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+extern volatile uint8_t PINB, PINC, PIND, PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A, TIMSK0, TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint8_t MCUSR;
+
+unsigned int hostTimer1(void);
+
+//=========== Register bits ===========
+
+#define RXC0	7
+#define TXC0	6
+#define UDRE0	5
+#define FE0		4
+#define DOR0	3
+#define UPE0	2
+#define U2X0	1
+
+#define RXCIE0	7
+#define TXCIE0	6
+#define UDRIE0	5
+#define RXEN0	4
+#define TXEN0	3
+#define UCSZ02	2
+
+#define UCSZ01	2
+#define UCSZ00	1
+
+#define WGM01	1
+#define CS02	2
+#define CS01	1
+#define CS00	0
+#define OCIE0A	1
+
+#define CS12	2
+#define CS11	1
+#define CS10	0
+#define TOIE1	0
+
+#define PB0		0
+#define PB5		5
+#define PC5		5
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for <avr/pgmspace.h>. There is a single address space, and
+ * common.h maps the _P functions onto their plain counterparts.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <string.h>
+
+#include "../../../common.h"
+
+#endif
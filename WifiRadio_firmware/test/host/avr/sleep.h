@@ -0,0 +1,18 @@
+/*
+ * Host stand-in for <avr/sleep.h>. Sleeping waits until hostboard.c has run an
+ * interrupt handler.
+ */
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE		0
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()			hostSleep()
+
+void hostSleep(void);
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * Host stand-in for <avr/wdt.h>. The firmware only enables the watchdog to
+ * reset into the bootloader, which ends the host build.
+ */
+
+#ifndef HOST_AVR_WDT_H
+#define HOST_AVR_WDT_H
+
+#define WDTO_15MS			0
+
+#define wdt_enable(timeout)	hostReset()
+#define wdt_disable()
+
+void hostReset(void);
+
+#endif
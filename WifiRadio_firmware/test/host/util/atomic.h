@@ -0,0 +1,20 @@
+/*
+ * Host stand-in for <util/atomic.h>, on top of cli() and sei() in
+ * <avr/interrupt.h>. Like the original, the previous state comes back however
+ * the block is left.
+ */
+
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>
+
+unsigned char hostSaveCli(void);
+void hostRestoreState(const unsigned char *interruptsOn);
+void hostForceOn(const unsigned char *unused);
+
+#define ATOMIC_RESTORESTATE	unsigned char hostState __attribute__((cleanup(hostRestoreState))) = hostSaveCli()
+#define ATOMIC_FORCEON		unsigned char hostState __attribute__((cleanup(hostForceOn))) = hostSaveCli()
+#define ATOMIC_BLOCK(type)	for(type, hostToDo = 1; hostToDo; hostToDo = 0)
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for <util/delay.h>, in real time
+ */
+
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#define _delay_ms(ms)	hostDelay((ms) * 1000.0)
+#define _delay_us(us)	hostDelay(us)
+
+void hostDelay(double us);
+
+#endif
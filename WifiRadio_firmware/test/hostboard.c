@@ -0,0 +1,382 @@
+/*
+ * Host build of the firmware, for running it against interface.pl without the
+ * hardware (see rig.pl). main.c and the modules it uses are compiled
+ * unchanged, with the headers in host/ standing in for avr-libc; this file
+ * plays the part of the rest of the ATmega328:
+ *
+ * - The serial port is the master side of a pty pair. The slave side is the
+ *   "serial port" of the router, to hand to interface.pl. Bytes go both ways
+ *   at the pace of BAUD, through the firmware's interrupt handlers.
+ * - Timer0 interrupts every ms, once schedInit() has set it up, and Timer1
+ *   counts F_CPU/64 like the real one.
+ * - The display is simulated by lcdsim.c.
+ * - The buttons are pressed through commands on stdin.
+ *
+ * The firmware runs in the main thread, and the interrupt handlers in a
+ * second one. A lock stands in for the interrupt flag: the firmware holds it
+ * between cli() and sei(), the interrupt thread while it runs a handler. As
+ * on the AVR, interrupts are disabled at reset.
+ *
+ * Output, on stdout:
+ *   tty <device>                               first, the slave side of the pty
+ *   lcd <ms> <line 0>|<line 1>|<line 2>|<line 3>
+ *                                              the display changed, printed
+ *                                              when the firmware is idle
+ *   press <button> <ms>                        a button went down
+ * with non-printable characters, '|' and '\' in the lines as \xNN, and times
+ * in ms since the start.
+ *
+ * Commands, on stdin:
+ *   press <button>     hold a button (numbered as in buttons.h) down for HOLD_MS
+ *   quit
+ */
+
+//=========== Includes ===========
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "lcdsim.h"
+
+//=========== Defines ===========
+
+#define	BAUD			9600		// As in serial.h, which clashes with getline() in stdio.h
+#define	HOST_UDR_EMPTY	0x100		// Value of UDR0 that the firmware cannot write
+#define	BYTE_US			(10 * 1000000.0 / BAUD)	// Time to send a byte, with start and stop bit
+#define	HOLD_MS			200			// How long a press holds a button down
+#define	NUM_BUTTONS		6
+#define	POLL_US			100			// Interval at which the interrupt thread looks for work
+
+//=========== Function prototypes ===========
+
+int firmwareMain(void);				// main() of main.c, renamed by the Makefile
+
+//=========== Registers ===========
+
+volatile int hostUDR0;
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+volatile uint8_t PINB = 0xFF, PINC = 0xFF, PIND = 0xFF, PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+volatile uint8_t TCCR0A, TCCR0B, OCR0A, TIMSK0, TCCR1A, TCCR1B, TIMSK1;
+volatile uint8_t MCUSR;
+
+//=========== Local variables ===========
+
+static pthread_mutex_t cpuLock = PTHREAD_MUTEX_INITIALIZER;	// Held while interrupts are disabled
+static __thread unsigned char interruptsOn;	// The interrupt flag, as the thread sees it
+
+static pthread_mutex_t wakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeUp = PTHREAD_COND_INITIALIZER;
+static BOOL interrupted;			// An interrupt handler ran since the firmware went to sleep
+
+static struct timespec startTime;
+static int uart;					// Master side of the pty
+
+static uint8_t shown[LCD_LINES][LCD_DISP_LENGTH];	// Display contents last printed
+static BOOL shownValid;
+
+// Pin and bit of each button, as in buttons.h
+static volatile uint8_t *const buttonPin[NUM_BUTTONS] = { &PINB, &PIND, &PINB, &PIND, &PIND, &PINB };
+static const uint8_t buttonBit[NUM_BUTTONS] = { 4, 128, 2, 32, 64, 1 };
+static double releaseTime[NUM_BUTTONS];		// When each button held down goes up again, 0 if it is up
+
+//=========== Local functions ===========
+
+static double now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - startTime.tv_sec) * 1e6 + (t.tv_nsec - startTime.tv_nsec) / 1e3;
+}
+
+// Run an interrupt handler, with interrupts disabled as on the AVR, and wake
+// the firmware if it sleeps
+static void interrupt(void (*handler)(void))
+{
+	pthread_mutex_lock(&cpuLock);
+	handler();
+	pthread_mutex_unlock(&cpuLock);
+
+	pthread_mutex_lock(&wakeLock);
+	interrupted = TRUE;
+	pthread_cond_signal(&wakeUp);
+	pthread_mutex_unlock(&wakeLock);
+}
+
+// Print the display if it changed since it was last printed
+static void showDisplay(void)
+{
+	uint8_t cells[LCD_LINES][LCD_DISP_LENGTH];
+	char text[LCD_LINES * (LCD_DISP_LENGTH * 4 + 1)];
+	char *end = text;
+
+	lcdsimRead(cells);
+	if(shownValid && !memcmp(cells, shown, sizeof(shown)))
+	{
+		return;
+	}
+	memcpy(shown, cells, sizeof(shown));
+	shownValid = TRUE;
+
+	for(int y=0; y<LCD_LINES; y++)
+	{
+		for(int x=0; x<LCD_DISP_LENGTH; x++)
+		{
+			uint8_t c = cells[y][x];
+
+			if(c < ' ' || c > '~' || c == '|' || c == '\\')
+			{
+				end += sprintf(end, "\\x%02X", c);
+			}
+			else
+			{
+				*end++ = c;
+			}
+		}
+		*end++ = y < LCD_LINES - 1 ? '|' : '\0';
+	}
+
+	printf("lcd %.1f %s\n", now() / 1000, text);
+}
+
+// Handle a command from stdin
+static void command(const char *line)
+{
+	int button;
+
+	if(sscanf(line, "press %d", &button) == 1 && button >= 0 && button < NUM_BUTTONS)
+	{
+		*buttonPin[button] &= ~buttonBit[button];
+		releaseTime[button] = now() + HOLD_MS * 1000.0;
+		printf("press %d %.1f\n", button, now() / 1000);
+	}
+	else if(!strncmp(line, "quit", 4))
+	{
+		exit(0);
+	}
+	else
+	{
+		fprintf(stderr, "Unknown command: %s\n", line);
+	}
+}
+
+// Read the commands that came in on stdin
+static void readCommands(void)
+{
+	static char line[64];
+	static size_t len;
+	char c;
+
+	while(read(STDIN_FILENO, &c, 1) == 1)
+	{
+		if(c == '\n')
+		{
+			line[len] = '\0';
+			command(line);
+			len = 0;
+		}
+		else if(len < sizeof(line) - 1)
+		{
+			line[len++] = c;
+		}
+	}
+}
+
+// The peripherals, which interrupt the firmware
+static void *interrupts(void *unused)
+{
+	double nextTick = 0;
+	double nextRX = 0;
+	double nextTX = 0;
+
+	for(;;)
+	{
+		double t = now();
+
+		// Timer0 compare match every ms, once the scheduler started it
+		if(!(TIMSK0 & (1 << OCIE0A)))
+		{
+			nextTick = t + 1000;
+		}
+		while(t >= nextTick)
+		{
+			interrupt(TIMER0_COMPA_vect);
+			nextTick += 1000;
+		}
+
+		// A byte from the router
+		if(t >= nextRX && (UCSR0B & (1 << RXCIE0)))
+		{
+			unsigned char c;
+
+			if(read(uart, &c, 1) == 1)
+			{
+				hostUDR0 = c;
+				UCSR0A |= (1 << RXC0);
+				interrupt(USART_RX_vect);
+				UCSR0A &= ~(1 << RXC0);
+				nextRX = (nextRX + BYTE_US > t ? nextRX : t) + BYTE_US;
+			}
+		}
+
+		// A byte to the router, while the firmware has something to send
+		if(t >= nextTX && (UCSR0B & (1 << UDRIE0)))
+		{
+			hostUDR0 = HOST_UDR_EMPTY;
+			interrupt(USART_UDRE_vect);
+			if(hostUDR0 != HOST_UDR_EMPTY)
+			{
+				unsigned char c = hostUDR0;
+
+				if(write(uart, &c, 1) != 1)
+				{
+					perror("uart");
+				}
+				nextTX = (nextTX + BYTE_US > t ? nextTX : t) + BYTE_US;
+			}
+		}
+
+		readCommands();
+		for(int i=0; i<NUM_BUTTONS; i++)
+		{
+			if(releaseTime[i] && t >= releaseTime[i])
+			{
+				*buttonPin[i] |= buttonBit[i];
+				releaseTime[i] = 0;
+			}
+		}
+
+		usleep(POLL_US);
+	}
+
+	return NULL;
+}
+
+// Open a pty pair, and set up its slave side like a serial port without echo
+static int openUart(void)
+{
+	struct termios settings;
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if(master < 0 || grantpt(master) || unlockpt(master))
+	{
+		perror("pty");
+		exit(1);
+	}
+
+	// Keep the slave side open, or the master side reads nothing but errors
+	// while interface.pl has it closed
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if(slave < 0 || tcgetattr(slave, &settings))
+	{
+		perror(ptsname(master));
+		exit(1);
+	}
+	settings.c_lflag &= ~(ECHO | ECHOE | ECHOK | ECHONL);
+	tcsetattr(slave, TCSANOW, &settings);
+
+	fcntl(master, F_SETFL, O_NONBLOCK);
+	printf("tty %s\n", ptsname(master));
+	return master;
+}
+
+//=========== Host stand-ins for avr-libc ===========
+
+void hostCli(void)
+{
+	if(interruptsOn)
+	{
+		pthread_mutex_lock(&cpuLock);
+		interruptsOn = FALSE;
+	}
+}
+
+void hostSei(void)
+{
+	if(!interruptsOn)
+	{
+		interruptsOn = TRUE;
+		pthread_mutex_unlock(&cpuLock);
+	}
+}
+
+unsigned char hostSaveCli(void)
+{
+	unsigned char state = interruptsOn;
+
+	hostCli();
+	return state;
+}
+
+void hostRestoreState(const unsigned char *state)
+{
+	if(*state)
+	{
+		hostSei();
+	}
+}
+
+void hostForceOn(const unsigned char *unused)
+{
+	hostSei();
+}
+
+// Idle until an interrupt handler ran. The firmware is between tasks, so
+// this is when the display is complete.
+void hostSleep(void)
+{
+	showDisplay();
+
+	pthread_mutex_lock(&wakeLock);
+	while(!interrupted)
+	{
+		pthread_cond_wait(&wakeUp, &wakeLock);
+	}
+	interrupted = FALSE;
+	pthread_mutex_unlock(&wakeLock);
+}
+
+void hostDelay(double us)
+{
+	usleep(us);
+}
+
+unsigned int hostTimer1(void)
+{
+	return (unsigned long)(now() * (F_CPU / 64 / 1000000.0)) & 0xFFFF;
+}
+
+// The watchdog reset that starts the bootloader, which the host build has not
+void hostReset(void)
+{
+	printf("reset %.1f\n", now() / 1000);
+	exit(0);
+}
+
+//=========== Main ===========
+
+int main(void)
+{
+	pthread_t thread;
+
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
+	uart = openUart();
+
+	// Interrupts are disabled at reset
+	pthread_mutex_lock(&cpuLock);
+	pthread_create(&thread, NULL, interrupts, NULL);
+
+	return firmwareMain();
+}
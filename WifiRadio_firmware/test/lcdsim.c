@@ -0,0 +1,166 @@
+/*
+ * Simulated HD44780 display behind the API of lcd.h, for the host build of the
+ * firmware (see hostboard.c). It keeps the display RAM and the character
+ * generator RAM the way the controller does, so what the firmware sends ends
+ * up in the cells where the real display would show it.
+ */
+
+//=========== Includes ===========
+
+#include <string.h>
+
+#include "../lcd.h"
+#include "lcdsim.h"
+
+//=========== Defines ===========
+
+#define	DDRAM_SIZE		0x80
+#define	CGRAM_SIZE		0x40
+
+//=========== Local variables ===========
+
+static uint8_t ddram[DDRAM_SIZE];
+static uint8_t cgram[CGRAM_SIZE];
+static uint8_t address;		// Address counter
+static BOOL inCgram;		// The address counter points into the character generator RAM
+
+static const uint8_t lineStart[LCD_LINES] = { LCD_START_LINE1, LCD_START_LINE2, LCD_START_LINE3, LCD_START_LINE4 };
+
+//=========== Local functions ===========
+
+// Move to the start of the next line, as lcd.c does for a '\n'
+static void newline(void)
+{
+	if(address < LCD_START_LINE3)
+	{
+		address = LCD_START_LINE2;
+	}
+	else if(address >= LCD_START_LINE2 && address < LCD_START_LINE4)
+	{
+		address = LCD_START_LINE3;
+	}
+	else if(address >= LCD_START_LINE3 && address < LCD_START_LINE2)
+	{
+		address = LCD_START_LINE4;
+	}
+	else
+	{
+		address = LCD_START_LINE1;
+	}
+}
+
+//=========== Public functions ===========
+
+void lcd_command(uint8_t cmd)
+{
+	if(cmd & (1 << LCD_DDRAM))
+	{
+		address = cmd & (DDRAM_SIZE - 1);
+		inCgram = FALSE;
+	}
+	else if(cmd & (1 << LCD_CGRAM))
+	{
+		address = cmd & (CGRAM_SIZE - 1);
+		inCgram = TRUE;
+	}
+	else if(cmd & (1 << LCD_HOME))
+	{
+		address = 0;
+		inCgram = FALSE;
+	}
+	else if(cmd & (1 << LCD_CLR))
+	{
+		memset(ddram, ' ', sizeof(ddram));
+		address = 0;
+		inCgram = FALSE;
+	}
+}
+
+// Write to the RAM the address counter points into, and advance it. In two
+// line mode the display RAM is two lines of 40 at 0x00 and 0x40.
+void lcd_data(uint8_t data)
+{
+	if(inCgram)
+	{
+		cgram[address] = data;
+		address = (address + 1) & (CGRAM_SIZE - 1);
+		return;
+	}
+
+	ddram[address++] = data;
+	if(address == LCD_START_LINE1 + LCD_LINE_LENGTH)
+	{
+		address = LCD_START_LINE2;
+	}
+	else if(address == LCD_START_LINE2 + LCD_LINE_LENGTH)
+	{
+		address = LCD_START_LINE1;
+	}
+}
+
+void lcd_init(uint8_t dispAttr)
+{
+	lcd_clrscr();
+}
+
+void lcd_clrscr(void)
+{
+	lcd_command(1 << LCD_CLR);
+}
+
+void lcd_home(void)
+{
+	lcd_command(1 << LCD_HOME);
+}
+
+void lcd_gotoxy(uint8_t x, uint8_t y)
+{
+	lcd_command((1 << LCD_DDRAM) + lineStart[y] + x);
+}
+
+void lcd_putc(char c)
+{
+	if(c == '\n')
+	{
+		newline();
+	}
+	else
+	{
+		lcd_data(c);
+	}
+}
+
+void lcd_puts(const char *s)
+{
+	while(*s)
+	{
+		lcd_putc(*s++);
+	}
+}
+
+void lcd_puts_p(const char *progmem_s)
+{
+	lcd_puts(progmem_s);
+}
+
+// Like lcd.c, leaves the address counter where it was in the display RAM
+void lcd_cgram_p(uint8_t addr, const uint8_t *progmem_data, uint8_t len)
+{
+	uint8_t ddramAddress = address;
+
+	lcd_command((1 << LCD_CGRAM) + (addr & (CGRAM_SIZE - 1)));
+	while(len--)
+	{
+		lcd_data(*progmem_data++);
+	}
+	lcd_command((1 << LCD_DDRAM) + ddramAddress);
+}
+
+// Copy the visible cells
+void lcdsimRead(uint8_t cells[LCD_LINES][LCD_DISP_LENGTH])
+{
+	for(int y=0; y<LCD_LINES; y++)
+	{
+		memcpy(cells[y], &ddram[lineStart[y]], LCD_DISP_LENGTH);
+	}
+}
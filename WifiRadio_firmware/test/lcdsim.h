@@ -0,0 +1,15 @@
+/*
+ * Simulated display for the host build of the firmware, see lcdsim.c
+ */
+
+#ifndef LCDSIM_H
+#define LCDSIM_H
+
+#include <stdint.h>
+
+#include "../lcd.h"
+#include "../common.h"
+
+void lcdsimRead(uint8_t cells[LCD_LINES][LCD_DISP_LENGTH]);
+
+#endif
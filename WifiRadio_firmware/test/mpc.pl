@@ -0,0 +1,91 @@
+#!/usr/bin/perl -w
+
+# Stand-in for the mpc client, with just the commands interface.pl uses, for
+# running it against mpdstub.pl on a machine without mpc. Like mpc, it finds
+# MPD through MPD_HOST and MPD_PORT.
+#
+# Usage: mpc.pl ls [dir] | add <uri> | clear | playlist | play [n] | stop | next | prev |
+#               repeat on|off | volume [+-]n
+
+use strict;
+use IO::Socket::INET;
+
+my $host = $ENV{MPD_HOST} || "localhost";
+my $port = $ENV{MPD_PORT} || 6600;
+
+my $mpd = IO::Socket::INET->new(PeerAddr => $host, PeerPort => $port, Proto => "tcp")
+    or die "mpc: cannot connect to $host:$port\n";
+my $greeting = <$mpd>;
+
+sub quote($)
+{
+    my ($arg) = @_;
+
+    $arg =~ s/([\\"])/\\$1/g;
+    return "\"$arg\"";
+}
+
+# Send a command and return its response lines, without the OK
+sub command($)
+{
+    my ($command) = @_;
+    my @lines = ();
+
+    print $mpd "$command\n";
+    while(defined(my $line = <$mpd>))
+    {
+        return @lines if $line eq "OK\n";
+        die "mpc: $line" if $line =~ /^ACK /;
+        push(@lines, $line);
+    }
+    die "mpc: connection lost\n";
+}
+
+my ($verb, @args) = @ARGV;
+$verb = "status" if !defined $verb;
+
+if($verb eq "ls")
+{
+    foreach(command("lsinfo".(@args ? " ".quote($args[0]) : "")))
+    {
+        print "$1\n" if /^(?:directory|file|playlist): (.*)$/;
+    }
+}
+elsif($verb eq "playlist")
+{
+    foreach(command("playlistinfo"))
+    {
+        print "$1\n" if /^file: (.*)$/;
+    }
+}
+elsif($verb eq "add")
+{
+    command("add ".quote($args[0]));
+}
+elsif($verb eq "prev")
+{
+    command("previous");
+}
+elsif($verb eq "repeat")
+{
+    command("repeat ".($args[0] eq "on" ? 1 : 0));
+}
+elsif($verb eq "volume")
+{
+    command($args[0] =~ /^[+-]/ ? "volume $args[0]" : "setvol $args[0]");
+}
+elsif($verb eq "play" and @args)
+{
+    command("play ".($args[0] - 1));    # mpc counts from 1, MPD from 0
+}
+elsif($verb =~ /^(clear|play|stop|next|status)$/)
+{
+    my @lines = command(join(" ", $verb, @args));
+    print @lines if $verb eq "status";
+}
+else
+{
+    die "mpc: unknown command $verb\n";
+}
+
+print $mpd "close\n";
@@ -0,0 +1,17 @@
+#!/usr/bin/perl -w
+
+# Stand-in for netcat, for the way interface.pl uses it: send standard input
+# to a TCP port, and print what comes back until the other end closes.
+#
+# Usage: nc.pl host port
+
+use strict;
+use IO::Socket::INET;
+
+my ($host, $port) = @ARGV;
+my $sock = IO::Socket::INET->new(PeerAddr => $host, PeerPort => $port, Proto => "tcp")
+    or die "nc: cannot connect to $host:$port\n";
+
+print $sock $_ while <STDIN>;
+shutdown($sock, 1);
+print while <$sock>;
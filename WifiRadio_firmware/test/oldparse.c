@@ -0,0 +1,86 @@
+/*
+ * The track information parser as it was before parse.c, kept only as the
+ * reference for benchparse.c. It writes into the line it parses, does not
+ * check its strstr() results and only knows the fields of its time; do not
+ * use it for anything else.
+ */
+
+//=========== Includes ===========
+
+#include <string.h>
+#include <stdlib.h>
+
+//=========== Public functions ===========
+
+void oldProcessPlayingLine(char *RXserbuffer, char *artist, char *title,
+						int *playlistLength, int *songNum, int *songTime, int *songElapsed)
+{
+	char *artistPtr 	= strstr(RXserbuffer, "Artist: ");
+	char *titlePtr 		= strstr(RXserbuffer, "Title: ");
+	char *namePtr		= strstr(RXserbuffer, "Name: ");
+	char *plLengthPtr	= strstr(RXserbuffer, "playlistlength: ");
+	char *songPtr 		= strstr(RXserbuffer, "song: ");
+	char *timePtr 		= strstr(RXserbuffer, "time: ");
+
+	int stringLength = 0;
+
+	if(artistPtr && titlePtr)
+	{
+		char *artistStart = artistPtr + sizeof("Artist: ") - 1;
+		stringLength = titlePtr - (artistPtr + sizeof("Artist: ") - 1);
+		stringLength = stringLength > 20 ? 20 : stringLength;
+		strncpy(artist, artistStart , stringLength);
+	}
+	artist[stringLength] = '\0';
+
+	stringLength = 0;
+	if(titlePtr && namePtr)
+	{
+		char *titleStart = titlePtr + sizeof("Title: ") - 1;
+		stringLength = namePtr - (titlePtr + sizeof("Title: ") - 1);
+		stringLength = stringLength > 20 ? 20 : stringLength;
+		strncpy(title, titleStart, stringLength);
+	}
+	else if(titlePtr && plLengthPtr)
+	{
+		char *titleStart = titlePtr + sizeof("Title: ") - 1;
+		stringLength = plLengthPtr - (titlePtr + sizeof("Title: ") - 1);
+		stringLength = stringLength > 20 ? 20 : stringLength;
+		strncpy(title, titleStart, stringLength);
+	}
+	title[stringLength] = '\0';
+
+	if(namePtr && plLengthPtr)
+	{
+		char *nameStart = namePtr + sizeof("Name: ") - 1;
+		stringLength = plLengthPtr - (namePtr + sizeof("Name: ") - 1);
+		stringLength = stringLength > 20 ? 20 : stringLength;
+		strncpy(artist, nameStart , stringLength);
+		artist[stringLength] = '\0';
+	}
+
+	if(plLengthPtr && songPtr)
+	{
+		char *pllStart = plLengthPtr + sizeof("playlistlength: ") - 1;
+		stringLength = songPtr - (plLengthPtr + sizeof("playlistlength: ") - 1);
+		pllStart[stringLength] = '\0';
+		*playlistLength = atoi(pllStart);
+	}
+
+	if(songPtr && timePtr)
+	{
+		char *songStart = songPtr + sizeof("song: ") - 1;
+		stringLength = timePtr - (songPtr + sizeof("song: ") - 1);
+		songStart[stringLength] = '\0';
+		*songNum = atoi(songStart) + 1;
+	}
+
+	if(timePtr)
+	{
+		char *timeStart = timePtr + sizeof("time: ") - 1;
+		char *songTotalTime = strstr(timeStart, ":") + 1;
+		*(songTotalTime-1) = '\0';
+		*songElapsed = atoi(timeStart);
+		*songTime = atoi(songTotalTime);
+	}
+}
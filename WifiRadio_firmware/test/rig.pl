@@ -0,0 +1,269 @@
+#!/usr/bin/perl -w
+
+# Runs the firmware against interface.pl without the hardware, and checks what
+# the display shows when the buttons are pressed. hostboard (the host build
+# of main.c, see hostboard.c) serves one end of a pty pair as the serial port,
+# and interface.pl runs on the other end, against mpdstub.pl instead of MPD.
+#
+# The buttons are pressed in a fixed scenario: browsing (moving, paging, going
+# into a directory and back up), playing an album, next and volume. After each
+# press the display has to show the expected text within $timeout seconds.
+# The time from the press to that screen is the keypress-to-screen latency,
+# as the user sees it. It includes the up to 100 ms until uiTask() polls the
+# buttons, the 9600 baud line both ways and interface.pl's round trip to MPD
+# for the presses that need the router. The browse part is repeated --rounds
+# times, and the latencies are printed per step at the end.
+#
+# Run from the test directory after "make hostboard" (or "make rig").
+# Exits with 1 when the display does not show what it should.
+#
+# Usage: rig.pl [--rounds 5] [--tracks 1000] [--latency ms] [--timeout 5] [--verbose]
+#
+# --latency delays the stub's responses, like a slow router; --verbose prints
+# every screen.
+
+use strict;
+use Getopt::Long;
+use IPC::Open2;
+use IO::Socket::INET;
+use File::Temp qw(tempdir);
+use File::Path qw(rmtree);
+use Cwd qw(abs_path);
+use FindBin;
+use POSIX qw(setpgid);
+use Time::HiRes qw(time sleep);
+
+my $rounds = 5;
+my $tracks = 1000;
+my $latency = 0;
+my $timeout = 5;                # seconds a screen may take to appear
+my $verbose = 0;
+
+GetOptions("rounds=i" => \$rounds, "tracks=i" => \$tracks, "latency=i" => \$latency,
+           "timeout=f" => \$timeout, "verbose" => \$verbose) or die "Invalid options\n";
+
+my $testDir = abs_path($FindBin::Bin);
+my $firmwareDir = abs_path("$testDir/..");
+my $workDir = tempdir("rig-XXXXXX", TMPDIR => 1);     # logs, kept when a step fails
+my $port = 20000 + $$ % 20000;
+
+# Buttons, as numbered in buttons.h
+my %buttons = (UP => 0, DOWN => 1, LEFT => 2, RIGHT => 3, ENTER => 4, SWITCH => 5);
+
+#=========== Processes ===========
+
+my @groups = ();                # process groups to stop at the end
+
+sub stopAll()
+{
+    kill("TERM", map { -$_ } @groups) if @groups;
+    @groups = ();
+}
+
+END
+{
+    my $status = $?;
+    stopAll();
+    $? = $status;
+}
+
+# Start a command in a process group of its own, so it can be stopped with
+# all its children
+sub spawn($$@)
+{
+    my ($log, $env, @command) = @_;
+    my $pid = fork();
+
+    die "Cannot fork: $!\n" unless defined $pid;
+    if(!$pid)
+    {
+        setpgid(0, 0);
+        chdir($workDir);
+        open(STDOUT, ">", "$workDir/$log");
+        open(STDERR, ">&STDOUT");
+        @ENV{keys %$env} = values %$env;
+        exec(@command) or die "Cannot run $command[0]: $!\n";
+    }
+    push(@groups, $pid);
+    return $pid;
+}
+
+sub startStub()
+{
+    spawn("mpdstub.log", {}, $^X, "$firmwareDir/mpdstub.pl", "--port", $port,
+          "--tracks", $tracks, "--latency", $latency);
+
+    my $deadline = time() + $timeout;
+    while(time() < $deadline)
+    {
+        return if IO::Socket::INET->new(PeerAddr => "localhost", PeerPort => $port, Proto => "tcp");
+        sleep(0.05);
+    }
+    die "mpdstub.pl does not answer on port $port\n";
+}
+
+sub startInterface($)
+{
+    my ($tty) = @_;
+
+    # interface.pl runs mpc and nc; the stand-ins are used in their place
+    mkdir("$workDir/bin");
+    symlink("$testDir/nc.pl", "$workDir/bin/nc") or die "Cannot link nc: $!\n";
+
+    spawn("interface.log", { PATH => "$workDir/bin:$ENV{PATH}", MPD_HOST => "localhost", MPD_PORT => $port,
+                             MPC => "$testDir/mpc.pl", STTY => "stty", METRICS_DIR => $workDir },
+          $^X, "$firmwareDir/interface.pl", $tty);
+}
+
+#=========== Display ===========
+
+my $boardOutput = "";
+my @screen = ("", "", "", "");  # lines of the display, with custom characters as \xNN
+my $screenTime = 0;             # when the display last changed, in ms of hostboard
+my $pressTime = 0;              # when the last button went down
+
+# Read a line from hostboard, waiting at most until the deadline. Returns
+# undef if none came.
+sub readBoard($)
+{
+    my ($deadline) = @_;
+
+    while($boardOutput !~ /\n/)
+    {
+        my $left = $deadline - time();
+        return undef if $left <= 0;
+        my $bits = "";
+        vec($bits, fileno(BOARD_OUT), 1) = 1;
+        next unless select($bits, undef, undef, $left);
+        sysread(BOARD_OUT, $boardOutput, 4096, length($boardOutput)) or die "hostboard stopped\n";
+    }
+    $boardOutput =~ s/^(.*)\n//;
+    return $1;
+}
+
+# Follow the output of hostboard until the display matches, or the timeout
+# passes. The check gets the lines of the display. Returns whether it matched.
+sub waitScreen($)
+{
+    my ($check) = @_;
+    my $deadline = time() + $timeout;
+
+    return 1 if $check->(@screen);
+    while(defined(my $line = readBoard($deadline)))
+    {
+        if($line =~ /^lcd ([\d.]+) (.*)$/)
+        {
+            $screenTime = $1;
+            @screen = split(/\|/, $2, -1);
+            print "  $screenTime |".join("|\n  ".(" " x length($screenTime))." |", @screen)."|\n" if $verbose;
+            return 1 if $check->(@screen);
+        }
+        elsif($line =~ /^press \d+ ([\d.]+)$/)
+        {
+            $pressTime = $1;
+        }
+    }
+    return 0;
+}
+
+#=========== Scenario ===========
+
+my $failures = 0;
+my %latencies = ();             # step => list of latencies in ms
+my @stepOrder = ();
+
+# Press a button and wait for the display to pass the check. Presses of the
+# same button need it to have been released in between, which takes 200 ms.
+sub step($$$)
+{
+    my ($name, $button, $check) = @_;
+
+    sleep(0.25);
+    print BOARD_IN "press $buttons{$button}\n";
+    $pressTime = -1;
+    waitScreen(sub { $pressTime >= 0 and $check->(@_) }) or $pressTime = -1;
+
+    if($pressTime < 0)
+    {
+        print "FAIL $name: the display shows\n  |".join("|\n  |", @screen)."|\n";
+        $failures++;
+        return;
+    }
+
+    my $ms = $screenTime - $pressTime;
+    push(@stepOrder, $name) unless exists $latencies{$name};
+    push(@{$latencies{$name}}, $ms < 0 ? 0 : $ms);
+    printf("ok   %-28s %6.1f ms\n", $name, $ms < 0 ? 0 : $ms) if $verbose;
+}
+
+# Checks on the lines of the display
+sub line($$)
+{
+    my ($y, $pattern) = @_;
+    return sub { $_[$y] =~ $pattern };
+}
+
+sub lines(@)
+{
+    my @checks = @_;
+    return sub { my @s = @_; !grep { !$_->(@s) } @checks };
+}
+
+#=========== Main ===========
+
+startStub();
+
+my $boardPid = open2(\*BOARD_OUT, \*BOARD_IN, "$testDir/hostboard") or die "Cannot run hostboard: $!\n";
+push(@groups, $boardPid);
+BOARD_IN->autoflush(1);
+my ($tty) = (readBoard(time() + $timeout) || "") =~ /^tty (\S+)$/ or die "hostboard did not say which tty\n";
+
+startInterface($tty);
+
+# The splash screen, then the playing screen once the router has answered
+# the firmware's hello
+$timeout += 10;
+waitScreen(line(0, qr/\(\d+ of \d+\)/)) or die "The playing screen did not come up:\n  |".join("|\n  |", @screen)."|\n";
+$timeout -= 10;
+
+step("browse", "SWITCH", lines(line(0, qr/^>Artist 00001/), line(1, qr/^ Artist 00002/)));
+for (1 .. $rounds)
+{
+    step("move down (local)", "DOWN", lines(line(0, qr/^ Artist 00001/), line(1, qr/^>Artist 00002/)));
+    step("enter directory", "RIGHT", lines(line(0, qr/^>Album 01/), line(1, qr/^ Album 02/)));
+    step("leave directory (local)", "LEFT", lines(line(0, qr/^ Artist 00001/), line(1, qr/^>Artist 00002/)));
+    step("move down (local)", "DOWN", line(2, qr/^>Artist 00003/));
+    step("move down (local)", "DOWN", line(3, qr/^>Artist 00004/));
+    step("next page", "DOWN", lines(line(0, qr/^>Artist 00005/), line(3, qr/^ Artist 00008/)));
+    step("previous page", "UP", lines(line(0, qr/^ Artist 00001/), line(3, qr/^>Artist 00004/)));
+    step("move up (local)", "UP", line(2, qr/^>Artist 00003/));
+    step("move up (local)", "UP", line(1, qr/^>Artist 00002/));
+    step("move up (local)", "UP", line(0, qr/^>Artist 00001/));
+}
+step("enter directory", "RIGHT", lines(line(0, qr/^>Album 01/), line(1, qr/^ Album 02/)));
+step("play album", "ENTER", lines(line(0, qr/\(1 of \d+\)/), sub { "@_" =~ /Track 01/ }));
+waitScreen(line(0, qr/\(1 of 12\)/)) or print "FAIL the album was not queued\n" and $failures++;
+step("next song (local)", "RIGHT", line(0, qr/\(2 of 12\)/));
+step("next song (router)", "RIGHT", lines(line(0, qr/\(3 of 12\)/), sub { "@_" =~ /Track 03/ }));
+step("volume up (local)", "UP", line(3, qr/^Vol /));
+
+print BOARD_IN "quit\n";
+stopAll();
+
+# Keypress-to-screen latency per step
+print "Keypress-to-screen latency in ms, 9600 baud, stub latency $latency ms\n";
+printf("%-28s %4s %8s %8s %8s\n", "step", "n", "min", "median", "max");
+for my $name (@stepOrder)
+{
+    my @ms = sort { $a <=> $b } @{$latencies{$name}};
+    printf("%-28s %4d %8.1f %8.1f %8.1f\n", $name, scalar(@ms), $ms[0], $ms[$#ms / 2], $ms[-1]);
+}
+
+if($failures)
+{
+    print "$failures steps failed, logs in $workDir\n";
+    exit(1);
+}
+print "All steps passed\n";
+rmtree($workDir);
+exit(0);
@@ -0,0 +1,128 @@
+#!/usr/bin/perl -w
+
+# Round trip through the bootloader in simavr (see "make sim-test"). The
+# bootloader runs in simavr's simduino board, which connects the UART to
+# /tmp/simavr-uart0, and flash.pl loads the firmware into it. Then:
+#
+# - Bytes that were single byte commands before BOOT_MAGIC ('?', 'C', 'W',
+#   'X') and a status line may not get an answer.
+# - flash.pl loads the firmware, which has to start.
+# - flash.pl --check resets the firmware into the bootloader again, and has to
+#   find every page as it was written.
+#
+# simduino's output goes to simduino.log. Exits with 1 when a step fails.
+#
+# Usage: simflash.pl [--simduino simduino.elf] bootloader.hex main.hex
+
+use strict;
+use Getopt::Long;
+use FindBin;
+use POSIX qw(setpgid);
+use Time::HiRes qw(time sleep);
+
+my $simduino = "simduino.elf";
+my $uart = "/tmp/simavr-uart0";
+my $timeout = 10;               # seconds for simduino to come up
+
+GetOptions("simduino=s" => \$simduino) or die "Invalid options\n";
+my ($bootHex, $firmwareHex) = @ARGV;
+die "Usage: simflash.pl [--simduino simduino.elf] bootloader.hex main.hex\n" unless defined $firmwareHex;
+
+my $flash = "$FindBin::Bin/../flash.pl";
+$ENV{STTY} = "stty";
+
+#=========== Simulator ===========
+
+my $simPid = 0;
+
+END
+{
+    my $status = $?;
+    kill("TERM", -$simPid) if $simPid;
+    $? = $status;
+}
+
+sub startSimulator()
+{
+    unlink($uart);
+    $simPid = fork();
+    die "Cannot fork: $!\n" unless defined $simPid;
+    if(!$simPid)
+    {
+        setpgid(0, 0);
+        open(STDOUT, ">", "simduino.log");
+        open(STDERR, ">&STDOUT");
+        exec($simduino, $bootHex) or die "Cannot run $simduino: $!\n";
+    }
+
+    my $deadline = time() + $timeout;
+    sleep(0.1) while !-e $uart and time() < $deadline;
+    die "$simduino did not create $uart, see simduino.log\n" unless -e $uart;
+    system("stty 9600 raw -echo < $uart") == 0 or die "Cannot set up $uart\n";
+}
+
+#=========== Steps ===========
+
+my $failures = 0;
+
+sub fail($)
+{
+    print "FAIL $_[0]\n";
+    $failures++;
+}
+
+# Run flash.pl, and return its output
+sub flash(@)
+{
+    my $output = `$^X $flash --tty $uart @_ $firmwareHex 2>&1`;
+    print $output;
+    return ($? == 0, $output);
+}
+
+# The bootloader has to stay silent until it gets BOOT_MAGIC
+sub checkStrayBytes()
+{
+    open(UART, "+<", $uart) or die "Cannot open $uart: $!\n";
+    binmode(UART);
+    syswrite(UART, "?CWX\x00\x01 Artist: \x010m Title: X?\n?\n");
+
+    my $bits = "";
+    vec($bits, fileno(UART), 1) = 1;
+    if(select($bits, undef, undef, 0.5))
+    {
+        my $reply = "";
+        sysread(UART, $reply, 64);
+        fail(sprintf("the bootloader answered stray bytes with %s", join(" ", map { sprintf("%02X", $_) } unpack("C*", $reply))));
+    }
+    close(UART);
+}
+
+#=========== Main ===========
+
+startSimulator();
+
+checkStrayBytes();
+
+my ($ok, $output) = flash("--force");
+if(!$ok)
+{
+    fail("flash.pl could not load $firmwareHex");
+}
+elsif($output !~ /^Done/m)
+{
+    fail("the firmware was not started");
+}
+
+($ok, $output) = flash("--check");
+if(!$ok or $output !~ /: 0 of \d+ pages differ/)
+{
+    fail("the pages do not read back as written");
+}
+
+if($failures)
+{
+    print "$failures steps failed\n";
+    exit(1);
+}
+print "All steps passed\n";
+exit(0);
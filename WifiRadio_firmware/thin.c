@@ -0,0 +1,201 @@
+/*
+ * Thin-client firmware. Instead of parsing player status and composing the
+ * screens itself, the radio leaves all of that to the router, which keeps the
+ * authoritative 20x4 frame and sends only the cells that changed:
+ *
+ *   scr: <id><pos><len><bytes>[<pos><len><bytes>...]
+ *
+ * id is a single digit, pos ('0' + 0..79) the first cell of a run and len
+ * ('0' + 1..20) its length; a run never crosses a line. The patch is written
+ * to the frame buffer and acknowledged with "cmd:scr <id>", so the router
+ * knows what the display shows and can diff against that. A patch that does
+ * not parse is not acknowledged; the router sends it again.
+ *
+ * Button presses go to the router as "cmd:key <n>", with n the button index
+ * from buttons.h. Build with THIN_CLIENT = 1 in the Makefile, and run
+ * interface.pl with THIN_CLIENT=1.
+ */
+
+//=========== Includes ===========
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "lcd.h"
+#include "common.h"
+#include "serial.h"
+#include "format.h"
+#include "glyph.h"
+#include "screen.h"
+#include "led.h"
+#include "sched.h"
+#include "link.h"
+#include "buttons.h"
+
+//=========== Defines ===========
+
+#define	PATCH_HEADER	6		// "scr: " and the id
+
+//=========== Function prototypes ===========
+
+void uiTask(void);
+void serialTask(void);
+void displayTask(void);
+BOOL applyPatch(const char *runs);
+void sendKey(unsigned char button);
+
+//=========== Global Variables ===========
+
+unsigned int gLastLinkErrors;	// Sum of the serial error counters when last checked
+
+// Task that runs 10 times per second: the LED and the buttons
+void uiTask(void)
+{
+	unsigned int linkErrors = serialErrors() + gLinkFailures;
+	if(linkErrors != gLastLinkErrors)
+	{
+		gLastLinkErrors = linkErrors;
+		ledFlash(LED_ERROR);
+	}
+	ledBackground(linkBusy() ? LED_WAITING : LED_OFF);
+	ledTick();
+
+	if(processButtonPress(UPBUTTON, UPBUTTONPIN) == TRUE)
+	{
+		sendKey(UPBUTTON);
+	}
+	if(processButtonPress(DOWNBUTTON, DOWNBUTTONPIN) == TRUE)
+	{
+		sendKey(DOWNBUTTON);
+	}
+	if(processButtonPress(LEFTBUTTON, LEFTBUTTONPIN) == TRUE)
+	{
+		sendKey(LEFTBUTTON);
+	}
+	if(processButtonPress(RIGHTBUTTON, RIGHTBUTTONPIN) == TRUE)
+	{
+		sendKey(RIGHTBUTTON);
+	}
+	if(processButtonPress(ENTERBUTTON, ENTERBUTTONPIN) == TRUE)
+	{
+		sendKey(ENTERBUTTON);
+	}
+	if(processButtonPress(SWITCHBUTTON, SWITCHBUTTONPIN) == TRUE)
+	{
+		sendKey(SWITCHBUTTON);
+	}
+}
+
+// Task that handles the lines received from the router
+void serialTask(void)
+{
+	char *serRXbuffer = getline();
+
+	if(!serRXbuffer)
+	{
+		return;
+	}
+
+	ledFlash(LED_RX);
+
+	if(!strcmp_P(serRXbuffer, PSTR("bootloader")))
+	{
+		startBootloader();
+	}
+	else if(!linkReceive(serRXbuffer) &&
+	   !strncmp_P(serRXbuffer, PSTR("scr: "), 5) && serRXbuffer[5] >= '0' && serRXbuffer[5] <= '9' &&
+	   applyPatch(serRXbuffer + PATCH_HEADER))
+	{
+		char ack[] = "cmd:scr 0\n";
+
+		ack[8] = serRXbuffer[5];
+		putbytes(ack, sizeof(ack) - 1);
+	}
+
+	releaseline();
+}
+
+// Task that writes the changed cells to the display
+void displayTask(void)
+{
+	screenFlush();
+}
+
+// Check the runs of a patch, and write them into the frame buffer if they
+// are all valid. A patch is applied completely or not at all.
+BOOL applyPatch(const char *runs)
+{
+	const char *run;
+
+	for(run = runs; *run; )
+	{
+		unsigned char pos = run[0] - '0';
+		unsigned char len = run[1] - '0';
+
+		if(run[0] < '0' || run[1] < '0' || pos >= LCD_LINES * LCD_WIDTH || len < 1 || len > LCD_WIDTH - pos % LCD_WIDTH ||
+		   memchr(run + 2, '\0', len))
+		{
+			return FALSE;
+		}
+		run += 2 + len;
+	}
+
+	if(run == runs)
+	{
+		return FALSE;
+	}
+
+	for(run = runs; *run; )
+	{
+		unsigned char pos = run[0] - '0';
+		unsigned char len = run[1] - '0';
+		char cells[LCD_WIDTH + 1];
+
+		// Text glyphs are pinned to their line from now on. The router only
+		// uses the text glyphs, which fit in CGRAM together, so they never
+		// need to be unpinned to make room.
+		memcpy(cells, run + 2, len);
+		cells[len] = '\0';
+		glyphText(cells, cells, pos / LCD_WIDTH);
+		screenPuts(pos % LCD_WIDTH, pos / LCD_WIDTH, cells);
+		run += 2 + len;
+	}
+
+	return TRUE;
+}
+
+// Tell the router a button was pressed
+void sendKey(unsigned char button)
+{
+	char stringBuffer[40];
+	char *end = formatCommandParam(stringBuffer, PSTR("key"), button);
+	linkSend(stringBuffer, end - stringBuffer);
+}
+
+// Main function
+int main(void)
+{
+	ledInit();
+	buttonInit();
+	inituart();
+
+	lcd_init(LCD_DISP_ON);
+	lcd_clrscr();
+	lcd_puts_P("    MPD Boombox\n    thin client");
+
+	schedInit();
+	sei();
+
+	// The router sends the complete screen after a hello
+	char hello[] = "cmd:hello\n";
+	linkSend(hello, sizeof(hello) - 1);
+
+	schedAddTask(serialTask, 1, 10);
+	schedAddTask(uiTask, 100, 20);
+	schedAddTask(displayTask, 50, 50);
+	schedAddTask(linkTask, 10, 10);
+	schedRun();
+
+	return 0;	// Never reached
+}